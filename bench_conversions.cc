@@ -0,0 +1,32 @@
+// Conversion-dense input for the type-cache microbenchmark (make bench).
+#include <cstdint>
+
+void sink(int32_t i, float f, int16_t s);
+
+#define CONV(n)                   \
+    {                             \
+        int64_t a##n = n;         \
+        int32_t b##n = a##n;      \
+        double c##n = a##n;       \
+        float d##n = c##n;        \
+        int16_t e##n = b##n;      \
+        sink(a##n, c##n, a##n);   \
+        b##n = c##n + a##n;       \
+    }
+#define CONV10(n) \
+    CONV(n##0) CONV(n##1) CONV(n##2) CONV(n##3) CONV(n##4) \
+    CONV(n##5) CONV(n##6) CONV(n##7) CONV(n##8) CONV(n##9)
+#define CONV100(n) \
+    CONV10(n##0) CONV10(n##1) CONV10(n##2) CONV10(n##3) CONV10(n##4) \
+    CONV10(n##5) CONV10(n##6) CONV10(n##7) CONV10(n##8) CONV10(n##9)
+
+void bench0() { CONV100(1) }
+void bench1() { CONV100(2) }
+void bench2() { CONV100(3) }
+void bench3() { CONV100(4) }
+void bench4() { CONV100(5) }
+void bench5() { CONV100(6) }
+void bench6() { CONV100(7) }
+void bench7() { CONV100(8) }
+void bench8() { CONV100(9) }
+void bench9() { CONV100(10) }
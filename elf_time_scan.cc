@@ -0,0 +1,398 @@
+/*
+ * Companion tool for the narrowing cast plugin: scans prebuilt ELF objects,
+ * shared libraries and ar archives for references to glibc's 32-bit time
+ * ABI, i.e. undefined symbols such as time or gettimeofday that a 32-bit
+ * build with _TIME_BITS=64 would have redirected to __time64 or
+ * __gettimeofday64. Files are memory-mapped and scanned in parallel.
+ * License: GPLv3
+ *
+ * Usage: elf_time_scan [-j N] [--all] <file>...
+ *   -j N   scan with N threads (default: one per CPU)
+ *   --all  also report 64-bit objects, whose time ABI is always 64-bit
+ *
+ * Exits with 1 if a 32-bit time symbol was found.
+ */
+
+// Standard Headers
+#include <ar.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ======================= Time ABI table =======================
+
+// Functions whose glibc ABI carries a 32-bit time on 32-bit targets, and the
+// symbol a _TIME_BITS=64 build calls instead.
+struct time_symbol {
+    const char *legacy;
+    const char *time64;
+};
+
+static const time_symbol time_symbols[] = {
+    {"time", "__time64"},
+    {"stime", "__stime64"},
+    {"gettimeofday", "__gettimeofday64"},
+    {"settimeofday", "__settimeofday64"},
+    {"adjtime", "__adjtime64"},
+    {"clock_gettime", "__clock_gettime64"},
+    {"clock_settime", "__clock_settime64"},
+    {"clock_getres", "__clock_getres64"},
+    {"clock_nanosleep", "__clock_nanosleep_time64"},
+    {"nanosleep", "__nanosleep64"},
+    {"difftime", "__difftime64"},
+    {"mktime", "__mktime64"},
+    {"timegm", "__timegm64"},
+    {"timelocal", "__timelocal64"},
+    {"localtime", "__localtime64"},
+    {"localtime_r", "__localtime64_r"},
+    {"gmtime", "__gmtime64"},
+    {"gmtime_r", "__gmtime64_r"},
+    {"ctime", "__ctime64"},
+    {"ctime_r", "__ctime64_r"},
+    {"timespec_get", "__timespec_get64"},
+    {"stat", "__stat64_time64"},
+    {"stat64", "__stat64_time64"},
+    {"__xstat", "__stat64_time64"},
+    {"__xstat64", "__stat64_time64"},
+    {"fstat", "__fstat64_time64"},
+    {"fstat64", "__fstat64_time64"},
+    {"__fxstat", "__fstat64_time64"},
+    {"__fxstat64", "__fstat64_time64"},
+    {"lstat", "__lstat64_time64"},
+    {"lstat64", "__lstat64_time64"},
+    {"__lxstat", "__lstat64_time64"},
+    {"__lxstat64", "__lstat64_time64"},
+    {"fstatat", "__fstatat64_time64"},
+    {"fstatat64", "__fstatat64_time64"},
+    {"__fxstatat", "__fstatat64_time64"},
+    {"__fxstatat64", "__fstatat64_time64"},
+    {"utime", "__utime64"},
+    {"utimes", "__utimes64"},
+    {"lutimes", "__lutimes64"},
+    {"futimes", "__futimes64"},
+    {"futimesat", "__futimesat64"},
+    {"futimens", "__futimens64"},
+    {"utimensat", "__utimensat64"},
+    {"select", "__select64"},
+    {"pselect", "__pselect64"},
+    {"ppoll", "__ppoll64"},
+    {"epoll_pwait2", "__epoll_pwait2_time64"},
+    {"getitimer", "__getitimer64"},
+    {"setitimer", "__setitimer64"},
+    {"timer_gettime", "__timer_gettime64"},
+    {"timer_settime", "__timer_settime64"},
+    {"timerfd_gettime", "__timerfd_gettime64"},
+    {"timerfd_settime", "__timerfd_settime64"},
+    {"getrusage", "__getrusage64"},
+    {"wait3", "__wait3_time64"},
+    {"wait4", "__wait4_time64"},
+    {"sched_rr_get_interval", "__sched_rr_get_interval64"},
+    {"sigtimedwait", "__sigtimedwait64"},
+    {"recvmmsg", "__recvmmsg64"},
+    {"sem_timedwait", "__sem_timedwait64"},
+    {"mq_timedsend", "__mq_timedsend_time64"},
+    {"mq_timedreceive", "__mq_timedreceive_time64"},
+    {"aio_suspend", "__aio_suspend_time64"},
+    {"pthread_cond_timedwait", "__pthread_cond_timedwait64"},
+    {"pthread_mutex_timedlock", "__pthread_mutex_timedlock64"},
+    {"pthread_rwlock_timedrdlock", "__pthread_rwlock_timedrdlock64"},
+    {"pthread_rwlock_timedwrlock", "__pthread_rwlock_timedwrlock64"},
+    {"pthread_timedjoin_np", "__pthread_timedjoin_np64"},
+};
+
+// Symbol names to their table entry; read-only once built.
+static std::unordered_map<std::string, const time_symbol *> g_legacy_symbols;
+static std::unordered_map<std::string, const time_symbol *> g_time64_symbols;
+
+static void init_time_symbols() {
+    for (const time_symbol &symbol : time_symbols) {
+        g_legacy_symbols[symbol.legacy] = &symbol;
+        g_time64_symbols[symbol.time64] = &symbol;
+    }
+}
+
+// ======================= ELF scanning =======================
+
+// What was found in one ELF object.
+struct elf_scan_result {
+    std::string name;  // File, or "archive(member)".
+    bool is_elf32;
+    std::vector<std::string> legacy;  // Undefined 32-bit time symbols, sorted.
+    unsigned time64;                  // Undefined time64 symbols.
+    std::string error;
+};
+
+// Reads integers of the object's byte order.
+struct elf_reader {
+    const unsigned char *data;
+    size_t size;
+    bool swap;
+
+    bool in_bounds(uint64_t offset, uint64_t len) const {
+        return offset <= size && len <= size - offset;
+    }
+    template <typename T>
+    T read(uint64_t offset) const {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        if (swap) {
+            unsigned char *bytes = (unsigned char *)&value;
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        return value;
+    }
+};
+
+// Scans the symbol tables of one ELF class. Ehdr, Shdr and Sym are the
+// class's structures; their fields are read through the reader.
+template <typename Ehdr, typename Shdr, typename Sym>
+static void scan_symbol_tables(const elf_reader &elf, elf_scan_result *result) {
+    if (!elf.in_bounds(0, sizeof(Ehdr))) {
+        result->error = "truncated ELF header";
+        return;
+    }
+    uint64_t shoff = elf.read<decltype(Ehdr().e_shoff)>(offsetof(Ehdr, e_shoff));
+    uint16_t shnum = elf.read<uint16_t>(offsetof(Ehdr, e_shnum));
+    uint16_t shentsize = elf.read<uint16_t>(offsetof(Ehdr, e_shentsize));
+    if (shnum == 0) return;  // Stripped of section headers; nothing to scan.
+    if (shentsize < sizeof(Shdr) || !elf.in_bounds(shoff, (uint64_t)shnum * shentsize)) {
+        result->error = "bad section header table";
+        return;
+    }
+
+    std::vector<std::string> legacy;
+    std::unordered_map<std::string, bool> seen;
+    for (unsigned i = 0; i < shnum; ++i) {
+        uint64_t shdr = shoff + (uint64_t)i * shentsize;
+        uint32_t type = elf.read<uint32_t>(shdr + offsetof(Shdr, sh_type));
+        if (type != SHT_SYMTAB && type != SHT_DYNSYM) continue;
+
+        uint64_t offset = elf.read<decltype(Shdr().sh_offset)>(shdr + offsetof(Shdr, sh_offset));
+        uint64_t size = elf.read<decltype(Shdr().sh_size)>(shdr + offsetof(Shdr, sh_size));
+        uint32_t link = elf.read<uint32_t>(shdr + offsetof(Shdr, sh_link));
+        if (link >= shnum || !elf.in_bounds(offset, size)) continue;
+
+        uint64_t strshdr = shoff + (uint64_t)link * shentsize;
+        uint64_t stroff =
+            elf.read<decltype(Shdr().sh_offset)>(strshdr + offsetof(Shdr, sh_offset));
+        uint64_t strsize = elf.read<decltype(Shdr().sh_size)>(strshdr + offsetof(Shdr, sh_size));
+        if (!elf.in_bounds(stroff, strsize)) continue;
+        const char *strtab = (const char *)elf.data + stroff;
+
+        for (uint64_t sym = offset; sym + sizeof(Sym) <= offset + size; sym += sizeof(Sym)) {
+            uint16_t shndx = elf.read<uint16_t>(sym + offsetof(Sym, st_shndx));
+            if (shndx != SHN_UNDEF) continue;
+            uint32_t name = elf.read<uint32_t>(sym + offsetof(Sym, st_name));
+            if (name == 0 || name >= strsize) continue;
+
+            size_t len = strnlen(strtab + name, strsize - name);
+            std::string symbol(strtab + name, len);
+            if (!seen.emplace(symbol, true).second) continue;  // In both tables.
+            if (g_legacy_symbols.count(symbol)) {
+                legacy.push_back(symbol);
+            } else if (g_time64_symbols.count(symbol)) {
+                result->time64++;
+            }
+        }
+    }
+    std::sort(legacy.begin(), legacy.end());
+    result->legacy.swap(legacy);
+}
+
+// Scans one ELF image in memory.
+static void scan_elf(const unsigned char *data, size_t size, elf_scan_result *result) {
+    result->is_elf32 = false;
+    result->time64 = 0;
+    if (size < EI_NIDENT || memcmp(data, ELFMAG, SELFMAG) != 0) {
+        result->error = "not an ELF file";
+        return;
+    }
+
+    const uint16_t probe = 1;
+    bool host_little = *(const unsigned char *)&probe == 1;
+    elf_reader elf = {data, size, (data[EI_DATA] == ELFDATA2LSB) != host_little};
+    if (data[EI_CLASS] == ELFCLASS32) {
+        result->is_elf32 = true;
+        scan_symbol_tables<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(elf, result);
+    } else if (data[EI_CLASS] == ELFCLASS64) {
+        scan_symbol_tables<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(elf, result);
+    } else {
+        result->error = "unknown ELF class";
+    }
+}
+
+// Scans the ELF members of an ar archive, one result per member.
+static void scan_archive(const std::string &path, const unsigned char *data, size_t size,
+                         std::vector<elf_scan_result> *results) {
+    const char *long_names = NULL;
+    size_t long_names_size = 0;
+    for (size_t offset = SARMAG; offset + 60 <= size;) {
+        const char *header = (const char *)data + offset;
+        size_t member_size = strtoul(std::string(header + 48, 10).c_str(), NULL, 10);
+        size_t start = offset + 60;
+        if (member_size > size - start) break;
+
+        std::string name(header, 16);
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name == "//") {
+            long_names = (const char *)data + start;
+            long_names_size = member_size;
+        } else if (name != "/" && name != "/SYM64/") {
+            if (name.size() > 1 && name[0] == '/' && long_names) {
+                size_t index = strtoul(name.c_str() + 1, NULL, 10);
+                if (index < long_names_size) {
+                    const char *end =
+                        (const char *)memchr(long_names + index, '\n', long_names_size - index);
+                    name.assign(long_names + index,
+                                end ? end - (long_names + index) : long_names_size - index);
+                }
+            }
+            if (!name.empty() && name[name.size() - 1] == '/') name.erase(name.size() - 1);
+
+            if (member_size >= SELFMAG && memcmp(data + start, ELFMAG, SELFMAG) == 0) {
+                elf_scan_result result;
+                result.name = path + "(" + name + ")";
+                scan_elf(data + start, member_size, &result);
+                results->push_back(result);
+            }
+        }
+        offset = start + member_size + (member_size & 1);
+    }
+}
+
+// Maps a file and scans it as an ELF object or an ar archive.
+static void scan_file(const std::string &path, std::vector<elf_scan_result> *results) {
+    elf_scan_result failure;
+    failure.name = path;
+    failure.is_elf32 = false;
+    failure.time64 = 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        failure.error = strerror(errno);
+        if (fd >= 0) close(fd);
+        results->push_back(failure);
+        return;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        failure.error = "empty file";
+        results->push_back(failure);
+        return;
+    }
+
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        failure.error = strerror(errno);
+        results->push_back(failure);
+        return;
+    }
+
+    const unsigned char *data = (const unsigned char *)map;
+    if (size >= SARMAG && memcmp(data, ARMAG, SARMAG) == 0) {
+        scan_archive(path, data, size, results);
+    } else {
+        elf_scan_result result;
+        result.name = path;
+        scan_elf(data, size, &result);
+        results->push_back(result);
+    }
+    munmap(map, size);
+}
+
+// ======================= Parallel driver =======================
+
+// Files are handed out through an atomic index; each result lands in its
+// file's slot so that output follows the command line order.
+struct scan_job {
+    const std::vector<std::string> *paths;
+    std::vector<std::vector<elf_scan_result> > *results;
+    std::atomic<size_t> next;
+};
+
+static void *scan_worker_main(void *arg) {
+    scan_job *job = (scan_job *)arg;
+    for (size_t i; (i = job->next++) < job->paths->size();) {
+        scan_file((*job->paths)[i], &(*job->results)[i]);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = 0;
+    bool all_classes = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--all") == 0) {
+            all_classes = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: %s [-j N] [--all] <file>...\n", argv[0]);
+        return 2;
+    }
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    threads = std::min<size_t>(threads, paths.size());
+    init_time_symbols();
+
+    std::vector<std::vector<elf_scan_result> > results(paths.size());
+    scan_job job;
+    job.paths = &paths;
+    job.results = &results;
+    job.next = 0;
+
+    std::vector<pthread_t> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, scan_worker_main, &job) == 0) workers.push_back(worker);
+    }
+    scan_worker_main(&job);
+    for (pthread_t worker : workers) pthread_join(worker, NULL);
+
+    unsigned affected = 0;
+    for (const std::vector<elf_scan_result> &file_results : results) {
+        for (const elf_scan_result &result : file_results) {
+            if (!result.error.empty()) {
+                fprintf(stderr, "elf_time_scan: %s: %s\n", result.name.c_str(),
+                        result.error.c_str());
+                continue;
+            }
+            if (result.legacy.empty() || (!result.is_elf32 && !all_classes)) continue;
+
+            affected++;
+            printf("%s: %s32-bit time symbols:", result.name.c_str(),
+                   result.is_elf32 ? "" : "(64-bit object) ");
+            for (const std::string &symbol : result.legacy) {
+                printf(" %s", symbol.c_str());
+            }
+            if (result.time64) printf(" (mixed with %u time64 symbols)", result.time64);
+            printf("\n");
+        }
+    }
+    return affected ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Companion tool for the narrowing cast plugin's layout-out option.
+ * Reads the record layout lines written by any number of units and reports
+ * record types whose layout differs between units, e.g. because some objects
+ * were built with -D_TIME_BITS=64 and others without.
+ * License: GPLv3
+ *
+ * Usage: layout_compare [--time-only] <layout file>...   ("-" reads stdin)
+ *
+ * Exits with 1 if a mismatch was found.
+ */
+
+// Standard Headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One distinct layout of a record type.
+struct layout_group {
+    std::string description;  // Size, alignment and fields of the first line seen.
+    std::string example_unit;
+    std::string location;
+    unsigned units;
+    bool holds_time;
+};
+
+// Layouts by type name, then by layout hash.
+struct record_layouts {
+    std::vector<layout_group> groups;
+    std::unordered_map<uint64_t, size_t> index;
+};
+static std::unordered_map<std::string, record_layouts> g_records;
+static std::vector<std::string> g_names;  // In order of first sight, for stable output.
+
+// Helper to split a line into its tab-separated fields.
+static std::vector<std::string> split_tabs(const std::string &line) {
+    std::vector<std::string> fields;
+    for (size_t start = 0;;) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab - start));
+        if (tab == std::string::npos) return fields;
+        start = tab + 1;
+    }
+}
+
+// Adds one "<name> <hash> <size> <align> <fields> <unit> <location>" line.
+static bool add_layout_line(const std::string &line) {
+    std::vector<std::string> fields = split_tabs(line);
+    if (fields.size() != 7) return false;
+
+    uint64_t hash = strtoull(fields[1].c_str(), NULL, 16);
+    auto inserted = g_records.emplace(fields[0], record_layouts());
+    record_layouts &record = inserted.first->second;
+    if (inserted.second) g_names.push_back(fields[0]);
+
+    auto group = record.index.emplace(hash, record.groups.size());
+    if (group.second) {
+        layout_group layout;
+        layout.description = "size " + fields[2] + ", align " + fields[3] + ", fields " +
+                             (fields[4].empty() ? "(none)" : fields[4]);
+        layout.example_unit = fields[5];
+        layout.location = fields[6];
+        layout.units = 0;
+        // A trailing ":t" on a field marks a time member.
+        layout.holds_time = (fields[4] + ",").find(":t,") != std::string::npos;
+        record.groups.push_back(layout);
+    }
+    record.groups[group.first->second].units++;
+    return true;
+}
+
+// Reads the layout lines of one file; false if it cannot be opened.
+static bool read_layout_file(const char *path) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "layout_compare: cannot open %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    char buf[65536];
+    unsigned line_num = 0;
+    while (fgets(buf, sizeof(buf), file)) {
+        line += buf;
+        if (line.empty() || line[line.size() - 1] != '\n') {
+            if (!feof(file)) continue;  // Longer than the buffer; read the rest.
+        } else {
+            line.erase(line.size() - 1);
+        }
+        ++line_num;
+        if (!line.empty() && !add_layout_line(line)) {
+            fprintf(stderr, "layout_compare: %s:%u: malformed layout line\n", path, line_num);
+        }
+        line.clear();
+    }
+    if (file != stdin) fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool time_only = false;
+    int files = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--time-only") == 0) {
+            time_only = true;
+        } else if (read_layout_file(argv[i])) {
+            files++;
+        } else {
+            return 2;
+        }
+    }
+    if (files == 0) {
+        fprintf(stderr, "usage: %s [--time-only] <layout file>...\n", argv[0]);
+        return 2;
+    }
+
+    unsigned mismatches = 0;
+    for (const std::string &name : g_names) {
+        const record_layouts &record = g_records[name];
+        if (record.groups.size() < 2) continue;
+
+        bool holds_time = false;
+        for (const layout_group &layout : record.groups) holds_time |= layout.holds_time;
+        if (time_only && !holds_time) continue;
+
+        mismatches++;
+        printf("%s: %zu different layouts%s\n", name.c_str(), record.groups.size(),
+               holds_time ? " (has time members)" : "");
+        for (const layout_group &layout : record.groups) {
+            printf("  %s\n    in %u unit(s), e.g. %s (%s)\n", layout.description.c_str(),
+                   layout.units, layout.example_unit.c_str(), layout.location.c_str());
+        }
+    }
+    printf("%zu record type(s), %u with mismatching layouts\n", g_names.size(), mismatches);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+/*
+ * Local analysis daemon for the narrowing cast plugin.
+ * Holds the suppression list, the known-API table and a cache of per-function
+ * results in memory, so that concurrent compiles share one copy instead of
+ * each loading them again. Plugins connect over a Unix-domain socket and start
+ * the daemon on demand; it exits after a period without clients.
+ * License: GPLv3
+ *
+ * Usage: narrowing_cast_daemon <socket> [suppress=<file>] [known-apis=<file>]
+ *                              [idle-timeout=<seconds>] [cache-entries=<n>]
+ *
+ * Protocol, one request and one reply line at a time; requests may be
+ * pipelined:
+ *   PING                      -> PONG
+ *   CONFIG <hash> <suppress file>\t<known-apis file>
+ *                             -> OK | STALE
+ *   SUPPRESSED <line> <file>  -> YES | NO
+ *   APIS                      -> the known-API lines, then "."
+ *   GET <key>                 -> VALUE <data> | MISS
+ *   PUT <key> <data>          -> OK
+ *
+ * CONFIG selects the files SUPPRESSED and APIS answer from, by the FNV-1a
+ * hash of their contents, and must come first. Files that were edited since
+ * the client hashed them are answered with STALE.
+ */
+
+// Standard Headers
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ======================= Configuration =======================
+
+// Set once at startup and read without locks afterwards.
+struct daemon_config {
+    std::string socket_path;
+    unsigned idle_timeout;  // Seconds without clients before exiting.
+    size_t cache_entries;   // Result cache capacity over all stripes.
+    std::string suppress_file;  // Loaded at startup, for the spawning compile.
+    std::string known_apis_file;
+};
+static daemon_config g_config;
+
+// The suppressions and known APIs of one set of client files.
+struct client_config {
+    // Suppressed locations, as "file:line" for one line or "file" for all of it.
+    std::unordered_set<std::string> suppressions;
+    std::vector<std::string> known_api_lines;
+};
+typedef std::shared_ptr<const client_config> client_config_ptr;
+
+// Loaded configurations by content hash. Clients keep theirs alive while an
+// evicted one is still in use.
+#define MAX_CLIENT_CONFIGS 16
+static pthread_mutex_t g_client_configs_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<uint64_t, client_config_ptr> g_client_configs;
+
+// Helper to fold bytes into a 64-bit FNV-1a hash, as the plugin does.
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Helper to read a whole file; false if it cannot be opened.
+static bool read_file(const std::string &path, std::string *content) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        fprintf(stderr, "narrowing_cast_daemon: cannot open %s: %s\n", path.c_str(),
+                strerror(errno));
+        return false;
+    }
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), file)) > 0;) content->append(buf, n);
+    fclose(file);
+    return true;
+}
+
+// Helper to collect the non-comment lines of a file's contents.
+static void split_config_lines(const std::string &content, std::vector<std::string> *lines) {
+    for (size_t start = 0; start < content.size();) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) end = content.size();
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
+
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(std::min(line.find('\r'), line.size()));
+        if (line.empty() || line[0] == '#') continue;
+        lines->push_back(line);
+    }
+}
+
+// Loads a client's files, either of which may be empty for none, and hashes
+// their contents the way the plugin does. NULL if a file cannot be read.
+static client_config_ptr load_client_config(const std::string &suppress_file,
+                                            const std::string &known_apis_file,
+                                            uint64_t *hash) {
+    std::string suppress;
+    std::string known_apis;
+    if (!suppress_file.empty() && !read_file(suppress_file, &suppress)) return NULL;
+    if (!known_apis_file.empty() && !read_file(known_apis_file, &known_apis)) return NULL;
+
+    *hash = 14695981039346656037ull;
+    *hash = hash_bytes(*hash, "suppress", sizeof("suppress"));
+    *hash = hash_bytes(*hash, suppress.data(), suppress.size());
+    *hash = hash_bytes(*hash, "known-apis", sizeof("known-apis"));
+    *hash = hash_bytes(*hash, known_apis.data(), known_apis.size());
+
+    std::shared_ptr<client_config> config(new client_config);
+    std::vector<std::string> lines;
+    split_config_lines(suppress, &lines);
+    config->suppressions.insert(lines.begin(), lines.end());
+    split_config_lines(known_apis, &config->known_api_lines);
+    return config;
+}
+
+// Helper to find the loaded configuration with a hash, or NULL.
+static client_config_ptr find_client_config(uint64_t hash) {
+    pthread_mutex_lock(&g_client_configs_lock);
+    auto it = g_client_configs.find(hash);
+    client_config_ptr config = it == g_client_configs.end() ? NULL : it->second;
+    pthread_mutex_unlock(&g_client_configs_lock);
+    return config;
+}
+
+static void add_client_config(uint64_t hash, const client_config_ptr &config) {
+    pthread_mutex_lock(&g_client_configs_lock);
+    if (g_client_configs.size() >= MAX_CLIENT_CONFIGS && !g_client_configs.count(hash)) {
+        g_client_configs.erase(g_client_configs.begin());  // Evict an arbitrary entry.
+    }
+    g_client_configs[hash] = config;
+    pthread_mutex_unlock(&g_client_configs_lock);
+}
+
+// ======================= Result cache =======================
+
+// Key-value cache split into independently locked stripes, so that parallel
+// clients rarely contend; lookups only take a stripe's read lock.
+class striped_cache {
+public:
+    striped_cache() : stripe_capacity_(0) {
+        for (stripe &s : stripes_) pthread_rwlock_init(&s.lock, NULL);
+    }
+
+    void set_capacity(size_t entries) { stripe_capacity_ = entries / STRIPES + 1; }
+
+    bool get(const std::string &key, std::string *value) {
+        stripe &s = stripe_for(key);
+        pthread_rwlock_rdlock(&s.lock);
+        auto it = s.entries.find(key);
+        bool found = it != s.entries.end();
+        if (found) *value = it->second;
+        pthread_rwlock_unlock(&s.lock);
+        return found;
+    }
+
+    void put(const std::string &key, const std::string &value) {
+        stripe &s = stripe_for(key);
+        pthread_rwlock_wrlock(&s.lock);
+        if (s.entries.size() >= stripe_capacity_ && !s.entries.count(key)) {
+            s.entries.erase(s.entries.begin());  // Evict an arbitrary entry.
+        }
+        s.entries[key] = value;
+        pthread_rwlock_unlock(&s.lock);
+    }
+
+private:
+    static const size_t STRIPES = 64;
+    struct stripe {
+        pthread_rwlock_t lock;
+        std::unordered_map<std::string, std::string> entries;
+    };
+
+    stripe &stripe_for(const std::string &key) {
+        return stripes_[std::hash<std::string>()(key) % STRIPES];
+    }
+
+    stripe stripes_[STRIPES];
+    size_t stripe_capacity_;
+};
+static striped_cache g_cache;
+
+// ======================= Client handling =======================
+
+static std::atomic<unsigned> g_active_clients(0);
+static std::atomic<time_t> g_last_activity(0);
+
+// Buffered line reader over a socket.
+struct line_reader {
+    int fd;
+    std::string buffer;
+
+    // Reads one line without its newline; false at end of stream or on error.
+    bool read_line(std::string *line) {
+        for (;;) {
+            size_t newline = buffer.find('\n');
+            if (newline != std::string::npos) {
+                line->assign(buffer, 0, newline);
+                buffer.erase(0, newline + 1);
+                return true;
+            }
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+        }
+    }
+};
+
+// Helper to send a whole reply; false if the client went away.
+static bool send_all(int fd, const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Helper to split "<word> <rest>" at the first space.
+static std::string split_word(const std::string &text, std::string *rest) {
+    size_t space = text.find(' ');
+    if (space == std::string::npos) {
+        rest->clear();
+        return text;
+    }
+    rest->assign(text, space + 1, std::string::npos);
+    return text.substr(0, space);
+}
+
+// Selects the configuration of a CONFIG request, loading its files if no
+// configuration with its hash is loaded yet.
+static std::string select_client_config(const std::string &args, client_config_ptr *config) {
+    std::string files;
+    uint64_t hash = strtoull(split_word(args, &files).c_str(), NULL, 16);
+    size_t tab = files.find('\t');
+    if (tab == std::string::npos) return "ERROR\n";
+
+    *config = find_client_config(hash);
+    if (*config) return "OK\n";
+
+    uint64_t loaded_hash;
+    client_config_ptr loaded =
+        load_client_config(files.substr(0, tab), files.substr(tab + 1), &loaded_hash);
+    if (!loaded || loaded_hash != hash) return "STALE\n";
+    add_client_config(hash, loaded);
+    *config = loaded;
+    return "OK\n";
+}
+
+// Answers one request line of a client using the given configuration.
+static std::string handle_request(const std::string &request, client_config_ptr *config) {
+    std::string args;
+    std::string command = split_word(request, &args);
+
+    if (command == "PING") return "PONG\n";
+    if (command == "CONFIG") return select_client_config(args, config);
+    if (command == "SUPPRESSED") {
+        if (!*config) return "ERROR\n";
+        std::string file;
+        std::string line = split_word(args, &file);
+        bool suppressed = (*config)->suppressions.count(file) ||
+                          (*config)->suppressions.count(file + ":" + line);
+        return suppressed ? "YES\n" : "NO\n";
+    }
+    if (command == "APIS") {
+        if (!*config) return "ERROR\n";
+        std::string reply;
+        for (const std::string &line : (*config)->known_api_lines) reply += line + "\n";
+        return reply + ".\n";
+    }
+    if (command == "GET") {
+        std::string value;
+        return g_cache.get(args, &value) ? "VALUE " + value + "\n" : "MISS\n";
+    }
+    if (command == "PUT") {
+        std::string value;
+        std::string key = split_word(args, &value);
+        g_cache.put(key, value);
+        return "OK\n";
+    }
+    return "ERROR\n";
+}
+
+static void *client_main(void *arg) {
+    line_reader reader;
+    reader.fd = (int)(intptr_t)arg;
+
+    client_config_ptr config;
+    std::string request;
+    while (reader.read_line(&request)) {
+        g_last_activity = time(NULL);
+        if (!send_all(reader.fd, handle_request(request, &config))) break;
+    }
+    close(reader.fd);
+    g_last_activity = time(NULL);
+    g_active_clients--;
+    return NULL;
+}
+
+// ======================= Socket setup =======================
+
+// Helper to fill a Unix-domain socket address; false if the path is too long.
+static bool make_address(const std::string &path, sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr->sun_path)) return false;
+    memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Helper to take the lock file next to the socket, which serializes binding
+// and removing it between daemons; -1 if it cannot be opened.
+static int lock_socket_path(const std::string &path) {
+    int fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd >= 0) flock(fd, LOCK_EX);
+    return fd;
+}
+
+// Binds the listening socket and records the identity of its file in bound.
+// A socket file left by a dead daemon is removed; if another daemon is
+// already serving, returns -1 so this one exits quietly. The whole sequence
+// runs under the socket's lock, so that two daemons starting at once cannot
+// remove each other's socket between the probe and the bind.
+static int open_listen_socket(const std::string &path, struct stat *bound) {
+    sockaddr_un addr;
+    if (!make_address(path, &addr)) {
+        fprintf(stderr, "narrowing_cast_daemon: socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int lock_fd = lock_socket_path(path);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 && connect(probe, (sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (alive || unlink(path.c_str()) != 0 ||
+            bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0 && (stat(path.c_str(), bound) != 0 || listen(fd, 128) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    if (lock_fd >= 0) close(lock_fd);
+    return fd;
+}
+
+// Removes the socket file under its lock, unless another daemon has replaced
+// it since this one bound it.
+static void remove_listen_socket(const std::string &path, const struct stat &bound) {
+    int lock_fd = lock_socket_path(path);
+    struct stat current;
+    if (stat(path.c_str(), &current) == 0 && current.st_dev == bound.st_dev &&
+        current.st_ino == bound.st_ino) {
+        unlink(path.c_str());
+    }
+    if (lock_fd >= 0) close(lock_fd);
+}
+
+// Parses "key=value" arguments after the socket path.
+static bool parse_daemon_args(int argc, char **argv) {
+    if (argc < 2) return false;
+    g_config.socket_path = argv[1];
+    g_config.idle_timeout = 600;
+    g_config.cache_entries = 1 << 20;
+
+    for (int i = 2; i < argc; ++i) {
+        const char *value = strchr(argv[i], '=');
+        if (!value) return false;
+        std::string key(argv[i], value++ - argv[i]);
+
+        if (key == "suppress") {
+            g_config.suppress_file = value;
+        } else if (key == "known-apis") {
+            g_config.known_apis_file = value;
+        } else if (key == "idle-timeout") {
+            g_config.idle_timeout = atoi(value);
+        } else if (key == "cache-entries") {
+            g_config.cache_entries = strtoul(value, NULL, 10);
+        } else {
+            fprintf(stderr, "narrowing_cast_daemon: unknown argument %s\n", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (!parse_daemon_args(argc, argv)) {
+        fprintf(stderr,
+                "usage: %s <socket> [suppress=<file>] [known-apis=<file>] "
+                "[idle-timeout=<seconds>] [cache-entries=<n>]\n",
+                argv[0]);
+        return 2;
+    }
+    // Preload the spawning compile's files, which clients name by absolute path.
+    uint64_t hash;
+    client_config_ptr config = load_client_config(g_config.suppress_file,
+                                                  g_config.known_apis_file, &hash);
+    if (!config) return 2;
+    add_client_config(hash, config);
+
+    signal(SIGPIPE, SIG_IGN);
+    g_cache.set_capacity(g_config.cache_entries);
+
+    struct stat bound;
+    int listen_fd = open_listen_socket(g_config.socket_path, &bound);
+    if (listen_fd < 0) return 1;
+
+    g_last_activity = time(NULL);
+    for (;;) {
+        pollfd pfd = {listen_fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 1000);
+        if (ready < 0 && errno != EINTR) break;
+
+        if (ready > 0) {
+            int client = accept(listen_fd, NULL, NULL);
+            if (client < 0) continue;
+
+            pthread_t thread;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            g_active_clients++;
+            g_last_activity = time(NULL);
+            if (pthread_create(&thread, &attr, client_main, (void *)(intptr_t)client) != 0) {
+                close(client);
+                g_active_clients--;
+            }
+            pthread_attr_destroy(&attr);
+            continue;
+        }
+
+        if (g_config.idle_timeout && g_active_clients == 0 &&
+            time(NULL) - g_last_activity >= (time_t)g_config.idle_timeout) {
+            break;
+        }
+    }
+
+    remove_listen_socket(g_config.socket_path, bound);
+    close(listen_fd);
+    return 0;
+}
@@ -17,9 +17,25 @@
 #include <plugin-version.h>
 
 // GCC Core Headers
+#include <attribs.h>
+#include <basic-block.h>
+#include <cgraph.h>
+#include <context.h>
 #include <cp/cp-tree.h>
 #include <function.h>
+#include <tree-ssa-alias.h>
+#include <gimple-expr.h>
+#include <gimple.h>
+#include <gimple-iterator.h>
+#include <cfghooks.h>
+#include <cfgloop.h>
+#include <ssa.h>
+#include <tree-into-ssa.h>
+#include <langhooks.h>
+#include <output.h>
+#include <sbitmap.h>
 #include <tree-iterator.h>
+#include <tree-pass.h>
 #include <tree.h>
 
 // GCC Utility Headers
@@ -27,21 +43,169 @@
 #include <tree-pretty-print.h>
 
 // Standard C++ Headers
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-// Required GCC plugin info
+// Required GCC plugin info. The version is part of the configuration hash, so
+// it must change whenever the plugin's findings or stored formats do.
 int plugin_is_GPL_compatible;
-__attribute__((unused)) static struct plugin_info my_plugin_info = {
-    .version = "8.1-Final-Fix",
+static struct plugin_info my_plugin_info = {
+    .version = "9.0",
     .help = "Detects 64-to-32 bit narrowing and other lossy numeric conversions.\n"};
 
+// Options parsed from -fplugin-arg-narrowing_cast_plugin-<key>[=<value>].
+struct plugin_options {
+    // Only report narrowing of values derived from time sources.
+    bool taint;
+    // Extra known time APIs, one "name [returns] [serializes] [in=N,..] [out=N,..]" per line.
+    const char *known_apis_file;
+    // Aggregate lossy stores into struct fields into one finding per field.
+    bool field_report;
+    // Report findings inside macro expansions once per macro definition site.
+    bool macro_aggregate;
+    // Number of expansion sites listed for an aggregated macro finding.
+    unsigned macro_samples;
+    // Nodes traversed per function before its analysis is truncated; 0 is unlimited.
+    unsigned node_budget;
+    // Analysis time per unit, in milliseconds, before the rest is skipped; 0 is unlimited.
+    unsigned time_budget_ms;
+    // Cache type descriptors per unit; disabling it is only useful for benchmarking.
+    bool type_cache;
+    // Print analysis statistics to stderr at the end of the unit.
+    bool stats;
+    // Only check conversions whose source type is spelled through a time typedef.
+    bool y2038_only;
+    // Extra time typedef names, comma-separated.
+    const char *time_typedefs;
+    // Suppressed locations, one "file" or "file:line" per line.
+    const char *suppress_file;
+    // Socket of the analysis daemon shared by concurrent compiles.
+    const char *daemon_socket;
+    // Daemon executable started when nothing listens on the socket.
+    const char *daemon_bin;
+    // Write a plain-text report of the unit's findings to this file.
+    const char *report_file;
+    // Embed the report in the object file, in REPORT_SECTION.
+    bool report_section;
+    // Print the configuration hash to stdout, for ccache's compiler_check.
+    bool print_config_hash;
+    // Database of per-function fingerprints; unchanged functions are not analyzed again.
+    const char *fingerprint_db;
+    // Report the stored findings of functions skipped as unchanged.
+    bool replay_findings;
+    // Skip the traversal of functions whose types allow no lossy conversion.
+    bool prefilter;
+    // Comma-separated rules to check; y2038 if not given.
+    const char *rules;
+    // Evaluate conversions under the ILP32 data model of 32-bit targets.
+    bool ilp32;
+    // Append a layout fingerprint of every record type defined in the unit here,
+    // or write it to a file of its own if this is a directory.
+    const char *layout_out;
+    // Don't report integer conversions whose source value provably fits.
+    bool value_ranges;
+    // Insert runtime range checks at the casts of reported conversions.
+    bool instrument;
+    // Expected dynamic checks per unit that instrument may add; 0 is unlimited.
+    unsigned long long check_budget;
+};
+static plugin_options g_options = {
+    false, /* taint */
+    NULL,  /* known_apis_file */
+    false, /* field_report */
+    false, /* macro_aggregate */
+    3,     /* macro_samples */
+    0,     /* node_budget */
+    0,     /* time_budget_ms */
+    true,  /* type_cache */
+    false, /* stats */
+    false, /* y2038_only */
+    NULL,  /* time_typedefs */
+    NULL,  /* suppress_file */
+    NULL,  /* daemon_socket */
+    "narrowing_cast_daemon", /* daemon_bin */
+    NULL,  /* report_file */
+    false, /* report_section */
+    false, /* print_config_hash */
+    NULL,  /* fingerprint_db */
+    false, /* replay_findings */
+    false, /* prefilter */
+    NULL,  /* rules */
+    false, /* ilp32 */
+    NULL,  /* layout_out */
+    true,  /* value_ranges */
+    false, /* instrument */
+    0,     /* check_budget */
+};
+
+// Non-allocated object file section holding the report; the linker
+// concatenates the reports of all objects.
+#define REPORT_SECTION ".narrowing_cast_report"
+
+// Per-function time-taint state. Parameters and then locals are numbered
+// densely on first sight so the taint set is a compact bit-vector. For the
+// interprocedural summary each local also records which inputs of the
+// function its value may derive from: the first 32 parameters, and the
+// results of the first 32 calls to functions that may return time data only
+// known to the IPA pass.
+struct taint_state {
+    tree fndecl;
+    std::unordered_map<tree, unsigned> local_index;
+    std::unordered_map<tree, unsigned> call_slots;  // CALL_EXPR to its input slot.
+    sbitmap tainted;
+    std::vector<uint64_t> param_deps;
+    uint64_t param_sinks;  // Inputs whose value reaches a narrowing conversion.
+};
+
+// Bits of an input dependency mask.
+#define PARAM_INPUT(i) (1ull << (i))
+#define CALL_INPUT(slot) (1ull << (32 + (slot)))
+#define PARAM_INPUTS 0xffffffffull
+
+// Interprocedural time-taint summary of one function. It is attached to the
+// FUNCTION_DECL as the internal attribute TIME_TAINT_ATTR so that it is
+// streamed with the declaration through LTO; plugins cannot register LTO
+// section types of their own.
+struct time_taint_summary {
+    bool returns_time;     // Return value is time-derived regardless of arguments.
+    uint64_t ret_deps;     // Inputs whose time data flows into the return value.
+    uint64_t param_sinks;  // Inputs narrowed inside the function.
+};
+#define TIME_TAINT_ATTR "y2038 taint"
+
+// Summaries of the functions analyzed so far in this unit.
+static std::unordered_map<tree, time_taint_summary> g_taint_summaries;
+
 // Data structure to pass information during the traversal.
 struct walk_data {
     tree function_return_type;
+    taint_state *taint;
+    unsigned nodes_visited;
+    long start_time;  // get_run_time() when the function's analysis started.
+    bool truncated;   // A budget ran out; the rest of the function is skipped.
 };
 
 // Forward declaration for our recursive traversal function.
 static void traverse_and_check_ast(tree node, walk_data *data);
+static bool expr_is_time_tainted(tree expr, const walk_data *data, uint64_t *param_deps = NULL);
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len);
+static bool walk_budget_exceeded(walk_data *data);
+static uint64_t hash_file(uint64_t hash, const char *path);
+struct stored_finding;
+static void record_replayed_finding(const stored_finding &stored, uint32_t function);
 
 // Helper to get a string representation of a type.
 static const char *get_type_name(tree type) {
@@ -59,11 +223,248 @@ static const char *get_type_name(tree type) {
     return "<unhandled type name>";
 }
 
+// Typedef names whose values are treated as time-derived. Extend them with
+// time-typedefs=<name>,<name>,...
+static const char *const time_typedef_names[] = {
+    "time_t", "__time_t", "__time64_t", "suseconds_t", "__suseconds_t", "__suseconds64_t",
+};
+
+// Identifiers of all time typedef names, built-in and user-configured.
+static std::unordered_set<tree> g_time_typedef_ids;
+
+// Resolves the time typedef names to identifiers, adding the comma-separated
+// user list if given.
+static void init_time_typedefs(const char *user_list) {
+    for (const char *name : time_typedef_names) {
+        g_time_typedef_ids.insert(get_identifier(name));
+    }
+    if (!user_list) return;
+
+    std::string names(user_list);
+    for (size_t start = 0; start <= names.size();) {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos) end = names.size();
+        if (end > start) {
+            g_time_typedef_ids.insert(get_identifier(names.substr(start, end - start).c_str()));
+        }
+        start = end + 1;
+    }
+}
+
+// Helper to find the first typedef of a set that a type is spelled through,
+// following the typedef chain (e.g. my_stamp_t -> time_t -> __time_t).
+// Returns its identifier, or NULL_TREE.
+static tree find_typedef_in_chain(tree type, const std::unordered_set<tree> &ids) {
+    while (type && TYPE_NAME(type) && TREE_CODE(TYPE_NAME(type)) == TYPE_DECL) {
+        tree decl = TYPE_NAME(type);
+        if (DECL_NAME(decl) && ids.count(DECL_NAME(decl))) {
+            return DECL_NAME(decl);
+        }
+        type = DECL_ORIGINAL_TYPE(decl);
+    }
+    return NULL_TREE;
+}
+
+// Helper to find the time typedef a type is spelled through, or NULL_TREE.
+static tree get_time_typedef(tree type) {
+    return find_typedef_in_chain(type, g_time_typedef_ids);
+}
+
+// Typedef names of file sizes and offsets, checked by the large-file rule.
+static const char *const file_size_typedef_names[] = {
+    "off_t",   "__off_t", "off64_t",   "__off64_t", "loff_t",     "__loff_t",
+    "size_t",  "ssize_t", "__ssize_t", "blkcnt_t",  "__blkcnt_t", "blkcnt64_t",
+};
+static std::unordered_set<tree> g_file_size_typedef_ids;
+
+static void init_file_size_typedefs() {
+    for (const char *name : file_size_typedef_names) {
+        g_file_size_typedef_ids.insert(get_identifier(name));
+    }
+}
+
+// Packed properties of a type, as needed by the narrowing check.
+enum type_kind { TYPE_KIND_OTHER, TYPE_KIND_INTEGER, TYPE_KIND_REAL, TYPE_KIND_POINTER };
+
+struct type_desc {
+    uint16_t precision;
+    uint8_t kind;  // A type_kind.
+    uint8_t is_unsigned : 1;
+    uint8_t is_time : 1;  // Spelled through a time typedef.
+    uint8_t is_file_size : 1;  // Spelled through a file size or offset typedef.
+};
+
+// ======================= ILP32 data model =======================
+
+// Typedef names that are 64 bits wide on 32-bit targets too, checked before
+// their LP64 underlying type (often long) decides.
+static const char *const fixed64_typedef_names[] = {
+    "int64_t",        "uint64_t",       "__int64_t",      "__uint64_t",
+    "int_least64_t",  "uint_least64_t", "intmax_t",       "uintmax_t",
+    "__intmax_t",     "__uintmax_t",    "off64_t",        "__off64_t",
+    "loff_t",         "__loff_t",       "blkcnt64_t",     "__blkcnt64_t",
+    "ino64_t",        "__ino64_t",
+};
+static std::unordered_set<tree> g_fixed64_typedef_ids;
+
+// The preprocessor only exists in the C-family front ends; weak references
+// keep the plugin loadable in lto1.
+#pragma weak parse_in
+#pragma weak cpp_defined
+#pragma weak cpp_lookup
+#pragma weak cpp_macro_definition
+
+// Whether time types are 64 bits on the simulated target: glibc selects them
+// with _TIME_BITS=64, which sets __USE_TIME_BITS64 on 32-bit targets. -1
+// until the preprocessor was asked, once the first types are described.
+static int g_ilp32_time_bits_64 = -1;
+
+// Helper to get the value of an object-like macro defined as an integer, or
+// -1 if it is not defined that way.
+static long get_macro_int_value(const char *name) {
+    const unsigned char *id = (const unsigned char *)name;
+    if (!cpp_defined(parse_in, id, strlen(name))) return -1;
+    cpp_hashnode *node = cpp_lookup(parse_in, id, strlen(name));
+    // The definition reads "NAME VALUE".
+    const char *definition = (const char *)cpp_macro_definition(parse_in, node);
+    if (!definition || strncmp(definition, name, strlen(name)) != 0) return -1;
+    const char *value = definition + strlen(name);
+    if (*value != ' ') return -1;
+    char *end;
+    long result = strtol(value + 1, &end, 0);
+    return end != value + 1 && *end == '\0' ? result : -1;
+}
+
+static bool ilp32_time_bits_64() {
+    if (g_ilp32_time_bits_64 < 0) {
+        g_ilp32_time_bits_64 = 0;
+        if (&parse_in && parse_in) {
+            g_ilp32_time_bits_64 =
+                get_macro_int_value("_TIME_BITS") == 64 ||
+                cpp_defined(parse_in, (const unsigned char *)"__USE_TIME_BITS64", 17);
+        }
+    }
+    return g_ilp32_time_bits_64;
+}
+
+static void init_ilp32_model() {
+    for (const char *name : fixed64_typedef_names) {
+        g_fixed64_typedef_ids.insert(get_identifier(name));
+    }
+}
+
+// Precision of a type under ILP32, where long and pointers are 32 bits and
+// time_t is too unless 64-bit time was requested. off_t follows the host's
+// headers, which pick __off64_t for _FILE_OFFSET_BITS=64.
+static unsigned ilp32_precision(tree type, unsigned kind, bool is_time, unsigned precision) {
+    if (kind == TYPE_KIND_POINTER) return 32;
+    if (kind != TYPE_KIND_INTEGER || precision != 64) return precision;
+
+    if (find_typedef_in_chain(type, g_fixed64_typedef_ids)) return 64;
+    if (is_time) return ilp32_time_bits_64() ? 64 : 32;
+    tree main_variant = TYPE_MAIN_VARIANT(type);
+    if (main_variant == long_integer_type_node || main_variant == long_unsigned_type_node) {
+        return 32;
+    }
+    return precision;
+}
+
+// Helper to compute the descriptor of a type from the tree.
+static type_desc compute_type_desc(tree type) {
+    type_desc desc = {0, TYPE_KIND_OTHER, 0, 0, 0};
+    if (!type || type == error_mark_node) return desc;
+
+    tree_code code = TREE_CODE(TYPE_MAIN_VARIANT(type));
+    if (code == INTEGER_TYPE) {
+        desc.kind = TYPE_KIND_INTEGER;
+    } else if (code == REAL_TYPE) {
+        desc.kind = TYPE_KIND_REAL;
+    } else if (code == POINTER_TYPE) {
+        desc.kind = TYPE_KIND_POINTER;
+    }
+    desc.precision = TYPE_PRECISION(type);
+    desc.is_unsigned = TYPE_UNSIGNED(type);
+    desc.is_time = get_time_typedef(type) != NULL_TREE;
+    desc.is_file_size = find_typedef_in_chain(type, g_file_size_typedef_ids) != NULL_TREE;
+    if (g_options.ilp32) {
+        desc.precision = ilp32_precision(type, desc.kind, desc.is_time, desc.precision);
+    }
+    return desc;
+}
+
+// Per-unit cache from type node to descriptor: an open-addressing table keyed
+// by pointer, so a check costs a hash probe instead of several tree accesses.
+class type_desc_cache {
+public:
+    type_desc_cache() : count_(0), hits_(0), misses_(0) {}
+
+    type_desc get(tree type) {
+        if (count_ * 2 >= keys_.size()) grow();
+
+        size_t mask = keys_.size() - 1;
+        for (size_t i = hash_pointer(type) & mask;; i = (i + 1) & mask) {
+            if (keys_[i] == type) {
+                hits_++;
+                return descs_[i];
+            }
+            if (keys_[i] == NULL_TREE) {
+                misses_++;
+                keys_[i] = type;
+                descs_[i] = compute_type_desc(type);
+                count_++;
+                return descs_[i];
+            }
+        }
+    }
+
+    unsigned long hits() const { return hits_; }
+    unsigned long misses() const { return misses_; }
+
+private:
+    static size_t hash_pointer(tree type) {
+        uintptr_t bits = (uintptr_t)type;
+        return (bits >> 4) ^ (bits >> 16);
+    }
+
+    void grow() {
+        std::vector<tree> old_keys;
+        std::vector<type_desc> old_descs;
+        old_keys.swap(keys_);
+        old_descs.swap(descs_);
+        size_t size = old_keys.empty() ? 256 : old_keys.size() * 2;
+        keys_.assign(size, NULL_TREE);
+        descs_.resize(size);
+
+        size_t mask = size - 1;
+        for (size_t j = 0; j < old_keys.size(); ++j) {
+            if (old_keys[j] == NULL_TREE) continue;
+            size_t i = hash_pointer(old_keys[j]) & mask;
+            while (keys_[i] != NULL_TREE) i = (i + 1) & mask;
+            keys_[i] = old_keys[j];
+            descs_[i] = old_descs[j];
+        }
+    }
+
+    std::vector<tree> keys_;
+    std::vector<type_desc> descs_;
+    size_t count_;
+    unsigned long hits_;
+    unsigned long misses_;
+};
+
+static type_desc_cache g_type_descs;
+
+// Helper to get the descriptor of a type, through the cache unless disabled.
+static type_desc get_type_desc(tree type) {
+    if (!g_options.type_cache || !type) return compute_type_desc(type);
+    return g_type_descs.get(type);
+}
+
 // Helper to check if a type is an integer or float.
 static bool is_numeric_type(tree type) {
     if (!type) return false;
-    type = TYPE_MAIN_VARIANT(type);
-    return TREE_CODE(type) == INTEGER_TYPE || TREE_CODE(type) == REAL_TYPE;
+    type_desc desc = get_type_desc(type);
+    return desc.kind == TYPE_KIND_INTEGER || desc.kind == TYPE_KIND_REAL;
 }
 
 // Helper to get the original type of an expression, looking through casts.
@@ -90,114 +491,2992 @@ static tree get_original_type(tree expr) {
         DEBUG_PRINT("      peeled to: %s\n", get_tree_code_name(TREE_CODE(current_expr)));
     }
 
-    if (!current_expr) return TREE_TYPE(expr);
+    if (!current_expr) return TREE_TYPE(expr);
+
+    // For binary expressions, the node's own type might not be promoted yet.
+    // Instead, deduce the result type by finding the widest operand type.
+    switch (TREE_CODE(current_expr)) {
+        case PLUS_EXPR:
+        case MINUS_EXPR:
+        case MULT_EXPR:
+        case TRUNC_DIV_EXPR:
+        case RDIV_EXPR: {
+            tree op0 = TREE_OPERAND(current_expr, 0);
+            tree op1 = TREE_OPERAND(current_expr, 1);
+            if (op0 && op1) {
+                tree type0 = get_original_type(op0);
+                tree type1 = get_original_type(op1);
+                type_desc desc0 = get_type_desc(type0);
+                type_desc desc1 = get_type_desc(type1);
+                if ((desc0.kind == TYPE_KIND_INTEGER || desc0.kind == TYPE_KIND_REAL) &&
+                    (desc1.kind == TYPE_KIND_INTEGER || desc1.kind == TYPE_KIND_REAL)) {
+                    if (desc0.precision > desc1.precision) {
+                        DEBUG_PRINT("    deduced binary expr type from operand 0: %s\n",
+                                    get_type_name(type0));
+                        return type0;
+                    } else {
+                        DEBUG_PRINT("    deduced binary expr type from operand 1: %s\n",
+                                    get_type_name(type1));
+                        return type1;
+                    }
+                }
+            }
+            break;  // Fallthrough to default behavior if operands are weird
+        }
+        default:
+            break;  // Do nothing, use default logic below
+    }
+
+    tree result_type = TREE_TYPE(current_expr);
+    DEBUG_PRINT("    original type is: %s\n", get_type_name(result_type));
+    return result_type;
+}
+
+// Whether converting a value of type from to type to may lose range or precision.
+static bool is_lossy_conversion(const type_desc &from, const type_desc &to) {
+    if (to.kind == TYPE_KIND_OTHER || from.kind == TYPE_KIND_OTHER) return false;
+    if (to.kind == TYPE_KIND_POINTER || from.kind == TYPE_KIND_POINTER) return false;
+
+    // Case 1: Standard narrowing conversion (e.g., int64 -> int32, double -> float)
+    bool standard_narrowing = (from.precision > to.precision && from.kind == to.kind);
+
+    // Case 2: int64 -> float (loss of precision)
+    bool int64_to_float =
+        (from.kind == TYPE_KIND_INTEGER &&
+         from.precision > 53 &&  // float has 24 bits, double 53. Long long definitely loses.
+         to.kind == TYPE_KIND_REAL);
+
+    // Case 3: double -> int (loss of precision and range)
+    bool float_to_int_narrowing = (from.kind == TYPE_KIND_REAL && to.kind == TYPE_KIND_INTEGER &&
+                                   from.precision > to.precision);
+
+    return standard_narrowing || int64_to_float || float_to_int_narrowing;
+}
+
+// ======================= Conversion rules =======================
+
+// Where a conversion happens; rules select the contexts they check.
+enum conversion_context {
+    CONTEXT_INITIALIZATION,  // Variable and aggregate initializers.
+    CONTEXT_ASSIGNMENT,
+    CONTEXT_IMPLICIT,  // Conversion expressions, including casts.
+    CONTEXT_ARGUMENT,  // Call arguments, against the parameter types.
+    CONTEXT_FORMAT,    // Variadic arguments, against their format specification.
+    CONTEXT_RETURN,
+    CONTEXT_COUNT
+};
+#define CONTEXT_BIT(context) (1u << (context))
+#define ALL_CONTEXTS ((1u << CONTEXT_COUNT) - 1)
+
+// A checker sharing the one traversal with the others. Predicates only look
+// at type descriptors.
+struct conversion_rule {
+    const char *name;  // As selected with rules=<name>,...
+    unsigned contexts;  // CONTEXT_BIT mask of the contexts checked.
+    bool time_taint;    // Subject to the taint filter.
+    bool (*matches)(const type_desc &from, const type_desc &to);
+    const char *label;    // Diagnostic prefix.
+    const char *summary;  // What the conversion does to the value.
+};
+
+static bool matches_pointer_truncation(const type_desc &from, const type_desc &to) {
+    return from.kind == TYPE_KIND_POINTER && to.kind == TYPE_KIND_INTEGER &&
+           to.precision < from.precision;
+}
+
+static bool matches_large_file(const type_desc &from, const type_desc &to) {
+    return from.is_file_size && is_lossy_conversion(from, to);
+}
+
+static bool matches_y2038(const type_desc &from, const type_desc &to) {
+    if (g_options.y2038_only && !from.is_time) return false;
+    return is_lossy_conversion(from, to);
+}
+
+// All rules, most specific first: a conversion is reported by the first
+// enabled rule that matches it.
+static const conversion_rule conversion_rules[] = {
+    // -Wformat already diagnoses pointers passed for integer conversions.
+    {"ptr-trunc", ALL_CONTEXTS & ~CONTEXT_BIT(CONTEXT_FORMAT), false, matches_pointer_truncation,
+     "pointer truncation", "pointer value truncated"},
+    {"large-file", ALL_CONTEXTS, false, matches_large_file, "large-file issue",
+     "size or offset truncated"},
+    {"y2038", ALL_CONTEXTS, true, matches_y2038, "Y2038 potential issue", "lossy conversion"},
+};
+#define RULE_COUNT (sizeof(conversion_rules) / sizeof(conversion_rules[0]))
+
+// Enabled rules per context, in registry order. Built by init_rules() and
+// read-only afterwards.
+static std::vector<uint8_t> g_rule_dispatch[CONTEXT_COUNT];
+static bool g_pointer_rule_enabled;
+// Whether only time-typed sources can match, with y2038-only and no rule but y2038.
+static bool g_time_sources_only;
+
+// Builds the dispatch table from a comma-separated rule list.
+static void init_rules(const char *list) {
+    bool enabled[RULE_COUNT] = {};
+    std::string names(list ? list : "y2038");
+    for (size_t start = 0; start <= names.size();) {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos) end = names.size();
+        std::string name = names.substr(start, end - start);
+        start = end + 1;
+        if (name.empty()) continue;
+
+        size_t i = 0;
+        while (i < RULE_COUNT && name != conversion_rules[i].name) ++i;
+        if (i == RULE_COUNT) {
+            warning(0, "narrowing_cast_plugin: unknown rule %qs", name.c_str());
+            continue;
+        }
+        enabled[i] = true;
+    }
+
+    for (size_t i = 0; i < RULE_COUNT; ++i) {
+        if (!enabled[i]) continue;
+        for (int context = 0; context < CONTEXT_COUNT; ++context) {
+            if (conversion_rules[i].contexts & CONTEXT_BIT(context)) {
+                g_rule_dispatch[context].push_back(i);
+            }
+        }
+        if (conversion_rules[i].matches == matches_pointer_truncation) {
+            g_pointer_rule_enabled = true;
+        }
+    }
+
+    g_time_sources_only = g_options.y2038_only;
+    for (size_t i = 0; i < RULE_COUNT; ++i) {
+        if (enabled[i] && conversion_rules[i].matches != matches_y2038) {
+            g_time_sources_only = false;
+        }
+    }
+}
+
+// Returns the index of the first enabled rule matching a conversion, or -1.
+static int match_rule(conversion_context context, const type_desc &from, const type_desc &to) {
+    for (uint8_t rule : g_rule_dispatch[context]) {
+        if (conversion_rules[rule].matches(from, to)) return rule;
+    }
+    return -1;
+}
+
+// ======================= Value ranges =======================
+
+// Bounds of the values an integer expression can take. Without optimization
+// there is no value range propagation to consult, so the front end's trees
+// are evaluated directly: constants, masks, shifts, division, modulo, min/max,
+// conditionals and plain arithmetic. Anything else takes its type's range.
+struct expr_range {
+    widest_int min;
+    widest_int max;
+};
+
+// Operand depth evaluated before falling back to type ranges.
+#define RANGE_DEPTH_LIMIT 8
+
+// Conversions not reported because the source's range fits the target.
+static unsigned g_range_suppressed;
+
+// Helper to get the range of an integer type, at the precision of its descriptor.
+static bool get_type_range(tree type, expr_range *range) {
+    if (!type || !INTEGRAL_TYPE_P(type)) return false;
+    type_desc desc = get_type_desc(type);
+    if (desc.kind != TYPE_KIND_INTEGER || desc.precision == 0) return false;
+
+    signop sign = desc.is_unsigned ? UNSIGNED : SIGNED;
+    range->min = widest_int::from(wi::min_value(desc.precision, sign), sign);
+    range->max = widest_int::from(wi::max_value(desc.precision, sign), sign);
+    return true;
+}
+
+// Helper to limit a computed range to the expression's type: a result the
+// type cannot hold may have wrapped to any of its values.
+static bool clamp_to_type(tree expr, expr_range *range) {
+    expr_range type_range;
+    if (!get_type_range(TREE_TYPE(expr), &type_range)) return false;
+    if (wi::lts_p(range->min, type_range.min) || wi::gts_p(range->max, type_range.max)) {
+        *range = type_range;
+    }
+    return true;
+}
+
+// Helper to read a constant shift count or divisor that is small enough to
+// keep the arithmetic exact.
+static bool get_small_constant(tree expr, HOST_WIDE_INT *value) {
+    if (TREE_CODE(expr) != INTEGER_CST || !tree_fits_shwi_p(expr)) return false;
+    *value = tree_to_shwi(expr);
+    return true;
+}
+
+static bool evaluate_range(tree expr, expr_range *range, int depth = 0) {
+    if (!expr || !TREE_TYPE(expr)) return false;
+    if (TREE_CODE(expr) == INTEGER_CST) {
+        range->min = range->max = wi::to_widest(expr);
+        return true;
+    }
+    if (depth >= RANGE_DEPTH_LIMIT || !INTEGRAL_TYPE_P(TREE_TYPE(expr))) {
+        return get_type_range(TREE_TYPE(expr), range);
+    }
+
+    // Exact products and shifts of wider operands could exceed widest_int.
+    bool small = TYPE_PRECISION(TREE_TYPE(expr)) <= 64;
+    expr_range op0, op1;
+    HOST_WIDE_INT constant;
+    switch (TREE_CODE(expr)) {
+        case NOP_EXPR:
+        case CONVERT_EXPR:
+        case NON_LVALUE_EXPR:
+        case SAVE_EXPR:
+            if (!evaluate_range(TREE_OPERAND(expr, 0), range, depth + 1)) break;
+            return clamp_to_type(expr, range);
+
+        case BIT_AND_EXPR: {
+            if (!evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1) ||
+                !evaluate_range(TREE_OPERAND(expr, 1), &op1, depth + 1)) {
+                break;
+            }
+            // Masking with a non-negative value is bounded by that value.
+            bool positive0 = !wi::neg_p(op0.min);
+            bool positive1 = !wi::neg_p(op1.min);
+            if (!positive0 && !positive1) break;
+            range->min = 0;
+            range->max = positive0 && positive1 ? wi::smin(op0.max, op1.max)
+                                                : (positive0 ? op0.max : op1.max);
+            return clamp_to_type(expr, range);
+        }
+        case BIT_IOR_EXPR:
+        case BIT_XOR_EXPR: {
+            if (!evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1) ||
+                !evaluate_range(TREE_OPERAND(expr, 1), &op1, depth + 1) ||
+                wi::neg_p(op0.min) || wi::neg_p(op1.min)) {
+                break;
+            }
+            // No bits above the highest bit of either operand.
+            range->min = 0;
+            range->max = wi::mask<widest_int>(wi::floor_log2(wi::smax(op0.max, op1.max)) + 1,
+                                              false);
+            return clamp_to_type(expr, range);
+        }
+        case LSHIFT_EXPR:
+            if (!small || !get_small_constant(TREE_OPERAND(expr, 1), &constant) ||
+                constant < 0 || constant >= 64 ||
+                !evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1) || wi::neg_p(op0.min)) {
+                break;
+            }
+            range->min = wi::lshift(op0.min, constant);
+            range->max = wi::lshift(op0.max, constant);
+            return clamp_to_type(expr, range);
+        case RSHIFT_EXPR:
+            if (!get_small_constant(TREE_OPERAND(expr, 1), &constant) || constant < 0 ||
+                constant >= 128 || !evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1)) {
+                break;
+            }
+            range->min = wi::arshift(op0.min, constant);
+            range->max = wi::arshift(op0.max, constant);
+            return clamp_to_type(expr, range);
+
+        case TRUNC_DIV_EXPR:
+            if (!get_small_constant(TREE_OPERAND(expr, 1), &constant) || constant <= 0 ||
+                !evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1)) {
+                break;
+            }
+            range->min = wi::div_trunc(op0.min, constant, SIGNED);
+            range->max = wi::div_trunc(op0.max, constant, SIGNED);
+            return clamp_to_type(expr, range);
+        case TRUNC_MOD_EXPR: {
+            if (!get_small_constant(TREE_OPERAND(expr, 1), &constant) || constant == 0 ||
+                constant == HOST_WIDE_INT_MIN) {
+                break;
+            }
+            // The result has the sign of the dividend and is smaller than the divisor.
+            widest_int bound = constant > 0 ? constant - 1 : -(constant + 1);
+            bool known = evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1);
+            range->min = known && !wi::neg_p(op0.min) ? widest_int(0) : -bound;
+            range->max = known && !wi::neg_p(op0.max) ? wi::smin(bound, op0.max) : bound;
+            if (known && wi::neg_p(op0.max)) range->max = 0;
+            return clamp_to_type(expr, range);
+        }
+
+        case MIN_EXPR:
+        case MAX_EXPR:
+            if (!evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1) ||
+                !evaluate_range(TREE_OPERAND(expr, 1), &op1, depth + 1)) {
+                break;
+            }
+            if (TREE_CODE(expr) == MIN_EXPR) {
+                range->min = wi::smin(op0.min, op1.min);
+                range->max = wi::smin(op0.max, op1.max);
+            } else {
+                range->min = wi::smax(op0.min, op1.min);
+                range->max = wi::smax(op0.max, op1.max);
+            }
+            return true;
+        case COND_EXPR:
+            if (!evaluate_range(TREE_OPERAND(expr, 1), &op0, depth + 1) ||
+                !evaluate_range(TREE_OPERAND(expr, 2), &op1, depth + 1)) {
+                break;
+            }
+            range->min = wi::smin(op0.min, op1.min);
+            range->max = wi::smax(op0.max, op1.max);
+            return clamp_to_type(expr, range);
+
+        case PLUS_EXPR:
+        case MINUS_EXPR:
+        case MULT_EXPR: {
+            if (!small || !evaluate_range(TREE_OPERAND(expr, 0), &op0, depth + 1) ||
+                !evaluate_range(TREE_OPERAND(expr, 1), &op1, depth + 1)) {
+                break;
+            }
+            if (TREE_CODE(expr) == PLUS_EXPR) {
+                range->min = op0.min + op1.min;
+                range->max = op0.max + op1.max;
+            } else if (TREE_CODE(expr) == MINUS_EXPR) {
+                range->min = op0.min - op1.max;
+                range->max = op0.max - op1.min;
+            } else {
+                widest_int products[4] = {op0.min * op1.min, op0.min * op1.max,
+                                          op0.max * op1.min, op0.max * op1.max};
+                range->min = range->max = products[0];
+                for (const widest_int &product : products) {
+                    range->min = wi::smin(range->min, product);
+                    range->max = wi::smax(range->max, product);
+                }
+            }
+            return clamp_to_type(expr, range);
+        }
+        default:
+            break;
+    }
+    return get_type_range(TREE_TYPE(expr), range);
+}
+
+// Whether every value expr can take fits in to_type, so that converting it
+// loses nothing whatever its type.
+static bool value_range_fits(tree expr, tree to_type) {
+    expr_range target;
+    expr_range value;
+    if (!get_type_range(to_type, &target) || !evaluate_range(expr, &value)) return false;
+    return !wi::lts_p(value.min, target.min) && !wi::gts_p(value.max, target.max);
+}
+
+// ======================= Analysis daemon =======================
+
+// Connection to the daemon serving suppressions, known APIs and cached
+// results, or -1. On any error the connection is dropped and the plugin falls
+// back to loading its configuration itself.
+static int g_daemon_fd = -1;
+static std::string g_daemon_input;  // Received but not yet consumed.
+
+// Helper to connect to a Unix-domain socket; -1 on failure.
+static int connect_unix_socket(const char *path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // A stuck daemon must not stall the compile.
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// Starts a detached daemon on the socket, passing it this compile's
+// configuration files.
+static void spawn_daemon() {
+    std::vector<std::string> args;
+    args.push_back(g_options.daemon_bin);
+    args.push_back(g_options.daemon_socket);
+    if (g_options.suppress_file) args.push_back(std::string("suppress=") + g_options.suppress_file);
+    if (g_options.known_apis_file) {
+        args.push_back(std::string("known-apis=") + g_options.known_apis_file);
+    }
+    std::vector<char *> argv;
+    for (std::string &arg : args) argv.push_back(&arg[0]);
+    argv.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Fork twice so the daemon is reparented and outlives the compile.
+        setsid();
+        if (fork() != 0) _exit(0);
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, 0);
+        dup2(null_fd, 1);
+        dup2(null_fd, 2);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid > 0) waitpid(pid, NULL, 0);
+}
+
+static void disconnect_daemon() {
+    if (g_daemon_fd >= 0) close(g_daemon_fd);
+    g_daemon_fd = -1;
+    g_daemon_input.clear();
+}
+
+static bool daemon_request(const std::string &request, std::string *reply);
+
+// Helper to get the absolute path of a configuration file for the daemon,
+// whose working directory is not the compile's; empty if there is no file.
+static std::string get_daemon_path(const char *path) {
+    if (!path) return "";
+    char *resolved = realpath(path, NULL);
+    std::string result(resolved ? resolved : path);
+    free(resolved);
+    return result;
+}
+
+// Tells the daemon which files this compile uses and the hash of their
+// contents. The daemon keeps one configuration per hash and loads the files
+// when it has none for it, so edited files and other compiles sharing the
+// socket never get stale answers. False if the daemon cannot serve it.
+static bool send_daemon_config() {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_bytes(hash, "suppress", sizeof("suppress"));
+    hash = hash_file(hash, g_options.suppress_file);
+    hash = hash_bytes(hash, "known-apis", sizeof("known-apis"));
+    hash = hash_file(hash, g_options.known_apis_file);
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    std::string reply;
+    return daemon_request(std::string("CONFIG ") + hex + " " +
+                              get_daemon_path(g_options.suppress_file) + "\t" +
+                              get_daemon_path(g_options.known_apis_file),
+                          &reply) &&
+           reply == "OK";
+}
+
+// Connects to the daemon, starting it if nothing listens yet.
+static void init_daemon() {
+    if (!g_options.daemon_socket) return;
+
+    g_daemon_fd = connect_unix_socket(g_options.daemon_socket);
+    if (g_daemon_fd < 0) {
+        spawn_daemon();
+        for (int attempt = 0; attempt < 50 && g_daemon_fd < 0; ++attempt) {
+            usleep(20000);
+            g_daemon_fd = connect_unix_socket(g_options.daemon_socket);
+        }
+    }
+    if (g_daemon_fd < 0) {
+        warning(0, "narrowing_cast_plugin: cannot reach daemon at %qs; working without it",
+                g_options.daemon_socket);
+        return;
+    }
+    if (!send_daemon_config()) {
+        // The files changed while the daemon read them, or it can't read them.
+        warning(0, "narrowing_cast_plugin: daemon at %qs cannot serve this configuration; "
+                   "working without it",
+                g_options.daemon_socket);
+        disconnect_daemon();
+    }
+}
+
+// Reads one reply line from the daemon; false if the connection failed.
+static bool daemon_read_line(std::string *line) {
+    for (;;) {
+        size_t newline = g_daemon_input.find('\n');
+        if (newline != std::string::npos) {
+            line->assign(g_daemon_input, 0, newline);
+            g_daemon_input.erase(0, newline + 1);
+            return true;
+        }
+        char chunk[4096];
+        ssize_t n = recv(g_daemon_fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            disconnect_daemon();
+            return false;
+        }
+        g_daemon_input.append(chunk, n);
+    }
+}
+
+// Sends a request line to the daemon and reads the first reply line.
+static bool daemon_request(const std::string &request, std::string *reply) {
+    if (g_daemon_fd < 0) return false;
+
+    std::string line = request + "\n";
+    for (size_t sent = 0; sent < line.size();) {
+        ssize_t n = send(g_daemon_fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            disconnect_daemon();
+            return false;
+        }
+        sent += n;
+    }
+    return daemon_read_line(reply);
+}
+
+// Suppressed locations loaded from suppress_file when there is no daemon.
+static std::unordered_set<std::string> g_suppressions;
+static bool g_suppressions_loaded;
+
+static void load_suppressions_file(const char *path) {
+    g_suppressions_loaded = true;
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        error("narrowing_cast_plugin: cannot open suppressions file %qs", path);
+        return;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        char *start = line + strspn(line, " \t");
+        start[strcspn(start, "\r\n")] = '\0';
+        if (*start == '#' || *start == '\0') continue;
+        g_suppressions.insert(start);
+    }
+    fclose(file);
+}
+
+// Answers received from the daemon, by "file:line".
+static std::unordered_map<std::string, bool> g_daemon_suppressed;
+
+// Requests per batch: small enough that the replies fit the socket buffers
+// while the requests are still being sent.
+#define SUPPRESSED_BATCH 256
+
+// Asks the daemon about all the given locations at once, pipelining the
+// requests in batches instead of one round trip per finding.
+static void prefetch_suppressions(const std::vector<expanded_location> &locs) {
+    if (g_daemon_fd < 0) return;
+
+    std::vector<std::string> keys;
+    std::string requests;
+    for (size_t i = 0; i <= locs.size(); ++i) {
+        if (i < locs.size()) {
+            if (!locs[i].file) continue;
+            char line_str[16];
+            snprintf(line_str, sizeof(line_str), "%d", locs[i].line);
+            std::string key = std::string(locs[i].file) + ":" + line_str;
+            if (!g_daemon_suppressed.emplace(key, false).second) continue;
+            keys.push_back(key);
+            requests += std::string("SUPPRESSED ") + line_str + " " + locs[i].file + "\n";
+            if (keys.size() < SUPPRESSED_BATCH) continue;
+        }
+        if (keys.empty()) break;
+
+        // The last request goes through daemon_request, which sends and reads its reply.
+        requests.erase(requests.size() - 1);
+        std::string reply;
+        if (!daemon_request(requests, &reply)) break;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            if (k && !daemon_read_line(&reply)) break;
+            g_daemon_suppressed[keys[k]] = reply == "YES";
+        }
+        keys.clear();
+        requests.clear();
+    }
+    if (g_daemon_fd < 0) g_daemon_suppressed.clear();
+}
+
+// Whether findings at a file and line are suppressed, asking the daemon if connected.
+static bool is_suppressed(const char *file, unsigned line) {
+    char line_str[16];
+    snprintf(line_str, sizeof(line_str), "%u", line);
+
+    auto it = g_daemon_suppressed.find(std::string(file) + ":" + line_str);
+    if (it != g_daemon_suppressed.end()) return it->second;
+    std::string reply;
+    if (daemon_request(std::string("SUPPRESSED ") + line_str + " " + file, &reply)) {
+        return reply == "YES";
+    }
+    if (!g_options.suppress_file) return false;
+    if (!g_suppressions_loaded) load_suppressions_file(g_options.suppress_file);
+    return g_suppressions.count(file) || g_suppressions.count(std::string(file) + ":" + line_str);
+}
+
+// ===================== Incremental analysis =====================
+
+// A function fingerprinted in this unit and the findings it produced, saved
+// to the fingerprint database at the end of the unit.
+struct function_fingerprint {
+    std::string key;  // "<absolute unit path>:<mangled name>".
+    uint64_t hash;
+    int line;  // Line of the function; findings are stored relative to it.
+    bool complete;  // Not truncated by a budget, so the findings can be reused.
+    std::string findings;  // STORED_FINDING_FIELDS fields per finding, each led by a tab.
+};
+static std::vector<function_fingerprint> g_function_fingerprints;
+
+// Fields stored per finding: line offset from the function, column, line and
+// column of the macro definition token (0 0 outside macros), rule index,
+// source type, target type, context and time typedef (empty if none).
+#define STORED_FINDING_FIELDS 9
+
+// A finding read back from the database for an unchanged function.
+struct stored_finding {
+    int line;  // Relative to the function.
+    int column;
+    int def_line;
+    int def_column;
+    int rule;
+    std::string from_type;
+    std::string to_type;
+    std::string context;
+    std::string time_typedef;
+    location_t loc;  // Of the node it was found at, once located in the body.
+};
+
+// Index marking findings that belong to no fingerprinted function.
+#define NO_FUNCTION UINT32_MAX
+static uint32_t g_current_function = NO_FUNCTION;
+
+// Database entries by key: the hash in hex, then the stored findings.
+static std::unordered_map<std::string, std::string> g_fingerprint_db;
+static bool g_fingerprint_db_loaded;
+static uint64_t g_config_hash;  // Set by plugin_init; part of every fingerprint.
+static unsigned g_unchanged_functions;
+
+// Generation of the database, from its "# generation <hex>" first line. It is
+// created with the file and prefixes the daemon's keys, so that the daemon's
+// cache never answers for a database that was deleted or replaced.
+static std::string g_fingerprint_generation;
+static bool g_fingerprint_generation_read;
+
+// Helper to fold bytes into a 64-bit FNV-1a hash.
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Helper to fold the contents of a file into a hash; nothing if it can't be read.
+static uint64_t hash_file(uint64_t hash, const char *path) {
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    if (!file) return hash;
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), file)) > 0;) hash = hash_bytes(hash, buf, n);
+    fclose(file);
+    return hash;
+}
+
+static uint64_t hash_name(uint64_t hash, const char *str) {
+    return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+// Helper to hash what the analysis sees of a type.
+static uint64_t hash_type(uint64_t hash, tree type) {
+    type_desc desc = get_type_desc(type);
+    hash = hash_bytes(hash, &desc, sizeof(desc));
+    return hash_name(hash, get_type_name(type));
+}
+
+struct fingerprint_walk {
+    uint64_t hash;
+    int base_line;  // Lines are hashed relative to the function.
+    walk_data *budget;
+};
+
+// walk_tree callback hashing the structure of a body: codes, types, names,
+// constants and relative positions, but not absolute locations.
+static tree fingerprint_node(tree *tp, int *walk_subtrees, void *data) {
+    (void)walk_subtrees;
+    fingerprint_walk *walk = (fingerprint_walk *)data;
+    tree node = *tp;
+    if (walk_budget_exceeded(walk->budget)) return node;
+    int code = TREE_CODE(node);
+    walk->hash = hash_bytes(walk->hash, &code, sizeof(code));
+
+    if (EXPR_P(node) && EXPR_HAS_LOCATION(node)) {
+        expanded_location xloc = expand_location(EXPR_LOCATION(node));
+        int position[2] = {xloc.line - walk->base_line, xloc.column};
+        walk->hash = hash_bytes(walk->hash, position, sizeof(position));
+    }
+    if (!TYPE_P(node) && TREE_TYPE(node)) {
+        walk->hash = hash_type(walk->hash, TREE_TYPE(node));
+    }
+
+    if (DECL_P(node)) {
+        if (DECL_NAME(node)) {
+            walk->hash = hash_name(walk->hash, IDENTIFIER_POINTER(DECL_NAME(node)));
+        }
+    } else if (TREE_CODE(node) == INTEGER_CST) {
+        HOST_WIDE_INT low = TREE_INT_CST_LOW(node);
+        walk->hash = hash_bytes(walk->hash, &low, sizeof(low));
+    } else if (TREE_CODE(node) == REAL_CST) {
+        char digits[64];
+        real_to_decimal(digits, TREE_REAL_CST_PTR(node), sizeof(digits), 0, 1);
+        walk->hash = hash_name(walk->hash, digits);
+    } else if (TREE_CODE(node) == STRING_CST) {
+        walk->hash = hash_bytes(walk->hash, TREE_STRING_POINTER(node), TREE_STRING_LENGTH(node));
+    }
+    return NULL_TREE;
+}
+
+// Helper to format a hash as 16 hex digits.
+static std::string hash_to_hex(uint64_t hash) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+
+// Reads the database file into g_fingerprint_db; a missing file is empty.
+static void load_fingerprint_db() {
+    g_fingerprint_db_loaded = true;
+    g_fingerprint_generation_read = true;
+    FILE *file = fopen(g_options.fingerprint_db, "r");
+    if (!file) return;
+
+    std::string line;
+    for (int c; (c = fgetc(file)) != EOF;) {
+        if (c != '\n') {
+            line += (char)c;
+            continue;
+        }
+        char generation[17];
+        size_t tab = line.find('\t');
+        if (line[0] == '#') {
+            if (sscanf(line.c_str(), "# generation %16s", generation) == 1) {
+                g_fingerprint_generation = generation;
+            }
+        } else if (tab != std::string::npos) {
+            g_fingerprint_db[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+        line.clear();
+    }
+    fclose(file);
+}
+
+// Helper to read the generation of the database without loading it; empty
+// if there is no database.
+static const std::string &get_fingerprint_generation() {
+    if (g_fingerprint_generation_read) return g_fingerprint_generation;
+    g_fingerprint_generation_read = true;
+    FILE *file = fopen(g_options.fingerprint_db, "r");
+    if (!file) return g_fingerprint_generation;
+    char generation[17];
+    if (fscanf(file, "# generation %16s", generation) == 1) g_fingerprint_generation = generation;
+    fclose(file);
+    return g_fingerprint_generation;
+}
+
+// Looks up the stored entry of a function. The database is authoritative:
+// the daemon only caches it, under its generation, and is filled from it.
+static bool lookup_fingerprint(const std::string &key, std::string *entry) {
+    const std::string &generation = get_fingerprint_generation();
+    if (generation.empty()) return false;
+
+    std::string reply;
+    std::string daemon_key = "fp:" + generation + ":" + key;
+    if (daemon_request("GET " + daemon_key, &reply) && reply.compare(0, 6, "VALUE ") == 0) {
+        *entry = reply.substr(6);
+        return true;
+    }
+
+    if (!g_fingerprint_db_loaded) load_fingerprint_db();
+    auto it = g_fingerprint_db.find(key);
+    if (it == g_fingerprint_db.end()) return false;
+    *entry = it->second;
+    daemon_request("PUT " + daemon_key + " " + *entry, &reply);
+    return true;
+}
+
+// Helper to get the position of the macro definition token a location was
+// expanded from; 0 0 if it is not in a macro expansion.
+static void get_macro_definition_position(location_t loc, int *line, int *column) {
+    *line = *column = 0;
+    if (!linemap_location_from_macro_expansion_p(line_table, loc)) return;
+    expanded_location xloc = expand_location(
+        linemap_resolve_location(line_table, loc, LRK_MACRO_DEFINITION_LOCATION, NULL));
+    *line = xloc.line;
+    *column = xloc.column;
+}
+
+struct replay_walk {
+    std::vector<stored_finding> *findings;
+    int base_line;
+    size_t unlocated;
+    walk_data *budget;
+};
+
+// walk_tree callback giving each stored finding the location of the node at
+// its position, so that it is reported, grouped and ranked like a new one.
+static tree locate_stored_finding(tree *tp, int *walk_subtrees, void *data) {
+    (void)walk_subtrees;
+    replay_walk *walk = (replay_walk *)data;
+    tree node = *tp;
+    if (walk_budget_exceeded(walk->budget)) return node;
+    location_t loc = UNKNOWN_LOCATION;
+    if (EXPR_P(node)) {
+        loc = EXPR_LOCATION(node);
+    } else if (DECL_P(node)) {
+        loc = DECL_SOURCE_LOCATION(node);
+    }
+    if (loc == UNKNOWN_LOCATION) return NULL_TREE;
+
+    expanded_location xloc = expand_location(loc);
+    int def_line, def_column;
+    get_macro_definition_position(loc, &def_line, &def_column);
+    for (stored_finding &stored : *walk->findings) {
+        if (stored.loc != UNKNOWN_LOCATION || stored.line != xloc.line - walk->base_line ||
+            stored.column != xloc.column || stored.def_line != def_line ||
+            stored.def_column != def_column) {
+            continue;
+        }
+        stored.loc = loc;
+        walk->unlocated--;
+    }
+    return walk->unlocated ? NULL_TREE : node;
+}
+
+// Parses the findings of an entry and locates them in the unchanged body.
+// False if the entry is malformed or a finding has no node to stand on.
+static bool locate_stored_findings(tree body, int base_line, const std::string &entry,
+                                   walk_data *data, std::vector<stored_finding> *findings) {
+    if (entry.size() <= 16) return true;
+    std::vector<std::string> fields;
+    for (size_t start = 17;;) {
+        size_t tab = entry.find('\t', start);
+        fields.push_back(entry.substr(start, tab - start));
+        if (tab == std::string::npos) break;
+        start = tab + 1;
+    }
+    if (fields.size() % STORED_FINDING_FIELDS != 0) return false;
+
+    for (size_t i = 0; i < fields.size(); i += STORED_FINDING_FIELDS) {
+        stored_finding stored;
+        stored.line = atoi(fields[i].c_str());
+        stored.column = atoi(fields[i + 1].c_str());
+        stored.def_line = atoi(fields[i + 2].c_str());
+        stored.def_column = atoi(fields[i + 3].c_str());
+        stored.rule = atoi(fields[i + 4].c_str());
+        stored.from_type = fields[i + 5];
+        stored.to_type = fields[i + 6];
+        stored.context = fields[i + 7];
+        stored.time_typedef = fields[i + 8];
+        stored.loc = UNKNOWN_LOCATION;
+        if (stored.rule < 0 || (size_t)stored.rule >= RULE_COUNT) return false;
+        findings->push_back(stored);
+    }
+
+    replay_walk walk;
+    walk.findings = findings;
+    walk.base_line = base_line;
+    walk.unlocated = findings->size();
+    walk.budget = data;
+    walk_tree_without_duplicates(&body, locate_stored_finding, &walk);
+    return walk.unlocated == 0;
+}
+
+// Helper to get the absolute path of the main input, so that keys do not
+// depend on the directory each compile runs in.
+static const std::string &get_fingerprint_unit() {
+    static std::string unit;
+    if (unit.empty()) unit = get_daemon_path(main_input_filename);
+    return unit;
+}
+
+// Fingerprints a function and registers it for saving. Returns true if it is
+// unchanged since the last build, so that its analysis can be skipped. The
+// walks are charged to the function's budget; a function that exhausts it is
+// registered as incomplete.
+static bool check_function_fingerprint(tree fndecl, tree body, walk_data *data) {
+    expanded_location fn_xloc = expand_location(DECL_SOURCE_LOCATION(fndecl));
+    fingerprint_walk walk;
+    walk.hash = hash_bytes(14695981039346656037ull, &g_config_hash, sizeof(g_config_hash));
+    walk.base_line = fn_xloc.line;
+    walk.budget = data;
+    walk.hash = hash_type(walk.hash, TREE_TYPE(DECL_RESULT(fndecl)));
+    for (tree parm = DECL_ARGUMENTS(fndecl); parm; parm = DECL_CHAIN(parm)) {
+        fingerprint_node(&parm, NULL, &walk);
+    }
+    walk_tree_without_duplicates(&body, fingerprint_node, &walk);
+
+    function_fingerprint fingerprint;
+    fingerprint.key = get_fingerprint_unit() + ":" +
+                      IDENTIFIER_POINTER(DECL_ASSEMBLER_NAME(fndecl));
+    std::replace(fingerprint.key.begin(), fingerprint.key.end(), ' ', '?');
+    std::replace(fingerprint.key.begin(), fingerprint.key.end(), '\t', '?');
+    fingerprint.hash = walk.hash;
+    fingerprint.line = fn_xloc.line;
+    fingerprint.complete = true;
+
+    std::string entry;
+    std::vector<stored_finding> replayed;
+    if (data->truncated || !lookup_fingerprint(fingerprint.key, &entry) ||
+        entry.compare(0, 16, hash_to_hex(walk.hash)) != 0 ||
+        (g_options.replay_findings &&
+         !locate_stored_findings(body, fn_xloc.line, entry, data, &replayed))) {
+        g_current_function = g_function_fingerprints.size();
+        g_function_fingerprints.push_back(fingerprint);
+        return false;
+    }
+
+    // Unchanged. The entry is written back with the database; replayed
+    // findings add themselves to it again when they are reported.
+    g_unchanged_functions++;
+    uint32_t function = g_function_fingerprints.size();
+    if (!g_options.replay_findings) fingerprint.findings = entry.substr(16);
+    g_function_fingerprints.push_back(fingerprint);
+    for (const stored_finding &stored : replayed) record_replayed_finding(stored, function);
+    return true;
+}
+
+// Merges this unit's complete fingerprints into the database. The file is
+// re-read under a lock so that concurrent compiles do not drop each other's
+// entries, and replaced atomically.
+static void save_fingerprint_db() {
+    if (!g_options.fingerprint_db || g_function_fingerprints.empty()) return;
+
+    std::string path(g_options.fingerprint_db);
+    int lock_fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0666);
+    if (lock_fd >= 0) flock(lock_fd, LOCK_EX);
+
+    g_fingerprint_db.clear();
+    g_fingerprint_generation.clear();
+    load_fingerprint_db();
+    if (g_fingerprint_generation.empty()) {
+        long seed[3] = {(long)time(NULL), (long)getpid(), get_run_time()};
+        g_fingerprint_generation = hash_to_hex(hash_bytes(g_config_hash, seed, sizeof(seed)));
+    }
+    std::string reply;
+    for (const function_fingerprint &fingerprint : g_function_fingerprints) {
+        if (!fingerprint.complete) continue;
+        std::string entry = hash_to_hex(fingerprint.hash) + fingerprint.findings;
+        g_fingerprint_db[fingerprint.key] = entry;
+        daemon_request("PUT fp:" + g_fingerprint_generation + ":" + fingerprint.key + " " + entry,
+                       &reply);
+    }
+
+    std::vector<std::string> keys;
+    for (const auto &item : g_fingerprint_db) keys.push_back(item.first);
+    std::sort(keys.begin(), keys.end());
+
+    char tmp_suffix[32];
+    snprintf(tmp_suffix, sizeof(tmp_suffix), ".tmp.%d", (int)getpid());
+    std::string tmp_path = path + tmp_suffix;
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if (!file) {
+        error("narrowing_cast_plugin: cannot write fingerprint database %qs", tmp_path.c_str());
+    } else {
+        fprintf(file, "# generation %s\n", g_fingerprint_generation.c_str());
+        for (const std::string &key : keys) {
+            fprintf(file, "%s\t%s\n", key.c_str(), g_fingerprint_db[key].c_str());
+        }
+        if (fclose(file) != 0 || rename(tmp_path.c_str(), path.c_str()) != 0) {
+            error("narrowing_cast_plugin: cannot write fingerprint database %qs", path.c_str());
+            unlink(tmp_path.c_str());
+        }
+    }
+
+    if (lock_fd >= 0) close(lock_fd);
+    g_fingerprint_db.clear();
+    g_fingerprint_db_loaded = false;
+    g_fingerprint_generation.clear();
+    g_fingerprint_generation_read = false;
+    g_function_fingerprints.clear();
+}
+
+// ======================= Findings storage =======================
+
+// Interning string table. Strings are stored once, back to back, and named by
+// their offset, so findings can refer to them with a 32-bit id.
+class string_table {
+public:
+    string_table() : count_(0) {}
+
+    // Returns the id of a string, adding it on first sight.
+    uint32_t intern(const char *str) {
+        size_t len = strlen(str);
+        uint32_t hash = hash_string(str, len);
+        if ((count_ + 1) * 2 > slots_.size()) grow();
+
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            uint32_t slot = slots_[i];
+            if (slot == 0) {
+                uint32_t id = chars_.size();
+                chars_.insert(chars_.end(), str, str + len + 1);
+                slots_[i] = id + 1;
+                count_++;
+                return id;
+            }
+            if (strcmp(&chars_[slot - 1], str) == 0) return slot - 1;
+        }
+    }
+
+    const char *get(uint32_t id) const { return &chars_[id]; }
+
+    // Frees all strings at once; previously returned ids become invalid.
+    void release() {
+        std::vector<char>().swap(chars_);
+        std::vector<uint32_t>().swap(slots_);
+        count_ = 0;
+    }
+
+private:
+    static uint32_t hash_string(const char *str, size_t len) {
+        uint32_t hash = 2166136261u;  // FNV-1a
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    void grow() {
+        std::vector<uint32_t> old_slots;
+        old_slots.swap(slots_);
+        slots_.assign(old_slots.empty() ? 256 : old_slots.size() * 2, 0);
+
+        size_t mask = slots_.size() - 1;
+        for (uint32_t slot : old_slots) {
+            if (slot == 0) continue;
+            const char *str = &chars_[slot - 1];
+            size_t i = hash_string(str, strlen(str)) & mask;
+            while (slots_[i] != 0) i = (i + 1) & mask;
+            slots_[i] = slot;
+        }
+    }
+
+    std::vector<char> chars_;
+    std::vector<uint32_t> slots_;  // Offset + 1 of each string; 0 marks a free slot.
+    size_t count_;
+};
+
+// A lossy conversion found in this unit. Records have a fixed size; all
+// strings live in g_strings.
+enum finding_kind {
+    FINDING_CONVERSION,      // A lossy conversion.
+    FINDING_TRUNCATED,       // A function's analysis hit a budget; context is its name.
+    FINDING_BUDGET_SKIPPED,  // Functions not analyzed at all after the unit's time budget.
+};
+
+struct finding {
+    uint8_t kind;    // A finding_kind.
+    uint32_t count;  // Nodes or functions, for budget findings.
+    location_t loc;
+    uint32_t file;  // Interned file name, or NO_STRING until flush_findings() expands loc.
+    uint32_t line;
+    uint32_t column;
+    uint32_t from_type;  // Interned type names.
+    uint32_t to_type;
+    uint32_t context;  // Interned conversion context.
+    uint32_t time_typedef;  // Interned time typedef of the source, or NO_STRING.
+    uint32_t function;  // Index in g_function_fingerprints, or NO_FUNCTION.
+    uint8_t rule;  // Index in conversion_rules.
+    int64_t exec_count;  // Highest profile count of the finding's line, or -1.
+};
+
+// String id marking an absent optional string.
+#define NO_STRING UINT32_MAX
+
+// Bump allocator for findings. Records are never freed one by one; the whole
+// arena is released at the end of the unit.
+class finding_arena {
+public:
+    finding_arena() : size_(0) {}
+
+    finding *allocate() {
+        if (size_ == blocks_.size() * BLOCK_RECORDS) {
+            blocks_.push_back(XNEWVEC(finding, BLOCK_RECORDS));
+        }
+        finding *record = &blocks_.back()[size_ % BLOCK_RECORDS];
+        size_++;
+        return record;
+    }
+
+    size_t size() const { return size_; }
+    finding &operator[](size_t i) { return blocks_[i / BLOCK_RECORDS][i % BLOCK_RECORDS]; }
+
+    void release() {
+        for (finding *block : blocks_) XDELETEVEC(block);
+        blocks_.clear();
+        size_ = 0;
+    }
+
+private:
+    static const size_t BLOCK_RECORDS = 4096;
+    std::vector<finding *> blocks_;
+    size_t size_;
+};
+
+// Identity of a finding: the same conversion reached again at the same
+// location, e.g. through a shared SAVE_EXPR, is reported only once.
+struct finding_key {
+    location_t loc;
+    const void *from_type;  // Type nodes, compared by identity only.
+    const void *to_type;
+    uint32_t context;
+
+    bool operator==(const finding_key &other) const {
+        return loc == other.loc && from_type == other.from_type && to_type == other.to_type &&
+               context == other.context;
+    }
+};
+
+struct finding_key_hash {
+    size_t operator()(const finding_key &key) const {
+        size_t hash = key.loc;
+        hash = hash * 31 + (size_t)key.from_type;
+        hash = hash * 31 + (size_t)key.to_type;
+        return hash * 31 + key.context;
+    }
+};
+
+static string_table g_strings;
+static finding_arena g_findings;
+static std::unordered_set<finding_key, finding_key_hash> g_finding_keys;
+
+// A conversion or budget finding lowered from the trees. Its strings are
+// interned when it is stored, so they only need to live until then.
+struct conversion_candidate {
+    uint8_t kind;  // A finding_kind.
+    uint8_t rule;  // Matching rule, for conversions.
+    uint32_t count;
+    location_t loc;
+    const void *from_key;  // Type nodes, used as identities for deduplication.
+    const void *to_key;
+    const char *from_name;
+    const char *to_name;
+    const char *context;
+    const char *time_typedef;  // Time typedef of the source, or NULL.
+    uint32_t function;  // Index in g_function_fingerprints, or NO_FUNCTION.
+};
+
+// Stores a candidate unless it was already found; it is reported by
+// flush_findings(), where the location is expanded.
+static void store_candidate(const conversion_candidate &candidate) {
+    uint32_t context_id = g_strings.intern(candidate.context);
+    if (candidate.kind == FINDING_CONVERSION) {
+        finding_key key = {candidate.loc, candidate.from_key, candidate.to_key, context_id};
+        if (!g_finding_keys.insert(key).second) {
+            DEBUG_PRINT("  duplicate finding, not recording.\n");
+            return;
+        }
+    }
+
+    finding *record = g_findings.allocate();
+    memset(record, 0, sizeof(*record));
+    record->kind = candidate.kind;
+    record->count = candidate.count;
+    record->loc = candidate.loc;
+    record->file = NO_STRING;
+    record->context = context_id;
+    record->time_typedef = NO_STRING;
+    record->function = candidate.function;
+    record->rule = candidate.rule;
+    record->exec_count = -1;
+    if (candidate.kind == FINDING_CONVERSION) {
+        record->from_type = g_strings.intern(candidate.from_name);
+        record->to_type = g_strings.intern(candidate.to_name);
+        if (candidate.time_typedef) record->time_typedef = g_strings.intern(candidate.time_typedef);
+    }
+}
+
+// Helper to lower a conversion between two types to a candidate.
+static conversion_candidate make_conversion_candidate(location_t loc, tree from_type,
+                                                      tree to_type, const char *context) {
+    conversion_candidate candidate;
+    memset(&candidate, 0, sizeof(candidate));
+    candidate.kind = FINDING_CONVERSION;
+    candidate.loc = loc;
+    candidate.from_key = from_type;
+    candidate.to_key = to_type;
+    candidate.from_name = get_type_name(from_type);
+    candidate.to_name = get_type_name(to_type);
+    candidate.context = context;
+    tree time_typedef = get_type_desc(from_type).is_time ? get_time_typedef(from_type) : NULL_TREE;
+    candidate.time_typedef = time_typedef ? IDENTIFIER_POINTER(time_typedef) : NULL;
+    candidate.function = g_current_function;
+    return candidate;
+}
+
+// Records a conversion already matched by a rule.
+static void record_finding(location_t loc, tree from_type, tree to_type, const char *context,
+                           int rule) {
+    conversion_candidate candidate = make_conversion_candidate(loc, from_type, to_type, context);
+    candidate.rule = rule;
+    store_candidate(candidate);
+}
+
+// Helper to format the time tag of a finding into buf; empty if not time-typed.
+static const char *get_time_tag(const finding &record, char *buf, size_t size) {
+    buf[0] = '\0';
+    if (record.time_typedef != NO_STRING) {
+        snprintf(buf, size, " (time-typed via %s)", g_strings.get(record.time_typedef));
+    }
+    return buf;
+}
+
+// Plain-text report of the unit, one "file:line:column: message" line per
+// diagnostic, in the order they are issued.
+static std::string g_report;
+
+// Appends a line to the report if one was requested.
+static void add_report_line(location_t loc, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+static void add_report_line(location_t loc, const char *format, ...) {
+    if (!g_options.report_file && !g_options.report_section) return;
+
+    expanded_location xloc = expand_location(loc);
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), ":%d:%d: ", xloc.line, xloc.column);
+    g_report += xloc.file ? xloc.file : "<unknown>";
+    g_report += prefix;
+    g_report += message;
+    g_report += '\n';
+}
+
+// ===================== Profile-guided ranking =====================
+
+// With -fprofile-use or -fauto-profile, each finding is ranked by how often
+// its line executed. A GIMPLE pass records the highest basic block count of
+// every statement location; it runs before the end of the unit, where the
+// findings are matched to those counts by file and line.
+static std::unordered_map<location_t, int64_t> g_location_counts;
+
+const pass_data pass_data_profile_counts = {
+    GIMPLE_PASS,       /* type */
+    "y2038_profile",   /* name */
+    OPTGROUP_NONE,     /* optinfo_flags */
+    TV_NONE,           /* tv_id */
+    PROP_cfg,          /* properties_required */
+    0,                 /* properties_provided */
+    0,                 /* properties_destroyed */
+    0,                 /* todo_flags_start */
+    0,                 /* todo_flags_finish */
+};
+
+class pass_profile_counts : public gimple_opt_pass {
+public:
+    pass_profile_counts(gcc::context *ctxt) : gimple_opt_pass(pass_data_profile_counts, ctxt) {}
+
+    virtual bool gate(function *) { return flag_profile_use || flag_auto_profile; }
+    virtual unsigned int execute(function *);
+};
+
+unsigned int pass_profile_counts::execute(function *fun) {
+    basic_block bb;
+    FOR_EACH_BB_FN(bb, fun) {
+        profile_count count = bb->count.ipa();
+        if (!count.initialized_p()) continue;
+        int64_t value = count.to_gcov_type();
+
+        for (gimple_stmt_iterator gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+            location_t loc = gimple_location(gsi_stmt(gsi));
+            if (loc == UNKNOWN_LOCATION) continue;
+            auto inserted = g_location_counts.emplace(loc, value);
+            if (!inserted.second && value > inserted.first->second) {
+                inserted.first->second = value;
+            }
+        }
+    }
+    return 0;
+}
+
+// Attaches the profile counts to the expanded findings. Statements and
+// findings rarely share a location_t, but they share lines.
+static void assign_execution_counts(const std::vector<size_t> &order) {
+    if (g_location_counts.empty()) return;
+
+    std::unordered_map<uint64_t, int64_t> line_counts;
+    for (const auto &item : g_location_counts) {
+        expanded_location xloc = expand_location(item.first);
+        if (!xloc.file) continue;
+        uint64_t key = (uint64_t)g_strings.intern(xloc.file) << 32 | (uint32_t)xloc.line;
+        auto inserted = line_counts.emplace(key, item.second);
+        if (!inserted.second && item.second > inserted.first->second) {
+            inserted.first->second = item.second;
+        }
+    }
+    for (size_t i : order) {
+        finding &record = g_findings[i];
+        if (record.file == NO_STRING) continue;
+        auto it = line_counts.find((uint64_t)record.file << 32 | record.line);
+        if (it != line_counts.end()) record.exec_count = it->second;
+    }
+    g_location_counts.clear();
+}
+
+// Helper to format the execution count of a finding into buf; empty without a profile.
+static const char *get_count_tag(const finding &record, char *buf, size_t size) {
+    buf[0] = '\0';
+    if (record.exec_count >= 0) {
+        snprintf(buf, size, " [executed %lld times]", (long long)record.exec_count);
+    }
+    return buf;
+}
+
+// Orders findings by execution count, hottest first, when a profile gave
+// counts, then by location and content, so that diagnostics and reports do
+// not depend on traversal order.
+struct finding_order {
+    static int compare_strings(uint32_t a, uint32_t b) {
+        if (a == b) return 0;
+        if (a == NO_STRING || b == NO_STRING) return a == NO_STRING ? -1 : 1;
+        return strcmp(g_strings.get(a), g_strings.get(b));
+    }
+
+    bool operator()(size_t a_index, size_t b_index) const {
+        const finding &a = g_findings[a_index];
+        const finding &b = g_findings[b_index];
+        if (a.exec_count != b.exec_count) return a.exec_count > b.exec_count;
+        int cmp = compare_strings(a.file, b.file);
+        if (cmp) return cmp < 0;
+        if (a.line != b.line) return a.line < b.line;
+        if (a.column != b.column) return a.column < b.column;
+        if (a.kind != b.kind) return a.kind < b.kind;
+        if ((cmp = compare_strings(a.context, b.context))) return cmp < 0;
+        if ((cmp = compare_strings(a.from_type, b.from_type))) return cmp < 0;
+        return compare_strings(a.to_type, b.to_type) < 0;
+    }
+};
+
+// Findings of one conversion at one macro definition site, over all of the
+// macro's expansions in the unit.
+struct macro_finding_group {
+    size_t first;  // Index of the first finding in g_findings.
+    location_t def_loc;
+    const char *macro_name;
+    unsigned uses;
+    std::vector<location_t> samples;  // Expansion points, at most macro_samples.
+};
+
+struct macro_group_key {
+    location_t def_loc;
+    uint32_t from_type;
+    uint32_t to_type;
+    uint32_t context;
+
+    bool operator==(const macro_group_key &other) const {
+        return def_loc == other.def_loc && from_type == other.from_type &&
+               to_type == other.to_type && context == other.context;
+    }
+};
+
+struct macro_group_key_hash {
+    size_t operator()(const macro_group_key &key) const {
+        size_t hash = key.def_loc;
+        hash = hash * 31 + key.from_type;
+        hash = hash * 31 + key.to_type;
+        return hash * 31 + key.context;
+    }
+};
+
+// Reports findings that came from macro expansions, one warning per group
+// with its use count and a bounded sample of expansion sites.
+static void report_macro_groups(const std::vector<macro_finding_group> &groups) {
+    for (const macro_finding_group &group : groups) {
+        const finding &record = g_findings[group.first];
+        char time_tag[128];
+        const conversion_rule &rule = conversion_rules[record.rule];
+        add_report_line(group.def_loc, "%s: %s from %s to %s in %s%s in expansion of macro '%s' "
+                        "(%u uses)",
+                        rule.label, rule.summary, g_strings.get(record.from_type),
+                        g_strings.get(record.to_type), g_strings.get(record.context),
+                        get_time_tag(record, time_tag, sizeof(time_tag)), group.macro_name,
+                        group.uses);
+        if (!warning_at(group.def_loc, 0,
+                        "%s: %s from %s to %s in %s%s in expansion of macro %qs (%u uses)",
+                        rule.label, rule.summary, g_strings.get(record.from_type),
+                        g_strings.get(record.to_type), g_strings.get(record.context),
+                        time_tag, group.macro_name, group.uses)) {
+            continue;
+        }
+        for (location_t sample : group.samples) {
+            inform(sample, "expanded from here");
+        }
+        if (group.uses > group.samples.size()) {
+            inform(group.def_loc, "and %u more expansion(s)",
+                   group.uses - (unsigned)group.samples.size());
+        }
+    }
+}
+
+// Stores a finding about the analysis budget, named by a function or a note.
+static void record_budget_finding(finding_kind kind, location_t loc, const char *name,
+                                  uint32_t count) {
+    conversion_candidate candidate;
+    memset(&candidate, 0, sizeof(candidate));
+    candidate.kind = kind;
+    candidate.count = count;
+    candidate.loc = loc;
+    candidate.function = NO_FUNCTION;
+    candidate.context = name;
+    store_candidate(candidate);
+}
+
+// Stores a finding replayed for an unchanged function. It was located in the
+// body, so it goes through suppression, grouping and ranking like a new one.
+static void record_replayed_finding(const stored_finding &stored, uint32_t function) {
+    finding *record = g_findings.allocate();
+    memset(record, 0, sizeof(*record));
+    record->kind = FINDING_CONVERSION;
+    record->loc = stored.loc;
+    record->file = NO_STRING;
+    record->from_type = g_strings.intern(stored.from_type.c_str());
+    record->to_type = g_strings.intern(stored.to_type.c_str());
+    record->context = g_strings.intern(stored.context.c_str());
+    record->time_typedef =
+        stored.time_typedef.empty() ? NO_STRING : g_strings.intern(stored.time_typedef.c_str());
+    record->function = function;
+    record->rule = stored.rule;
+    record->exec_count = -1;
+}
+
+// Adds a reported finding to the entry of the function it was found in.
+static void add_fingerprint_finding(const finding &record) {
+    function_fingerprint &fingerprint = g_function_fingerprints[record.function];
+    int def_line, def_column;
+    get_macro_definition_position(record.loc, &def_line, &def_column);
+    char position[96];
+    snprintf(position, sizeof(position), "\t%d\t%u\t%d\t%d\t%u",
+             (int)record.line - fingerprint.line, record.column, def_line, def_column,
+             (unsigned)record.rule);
+    fingerprint.findings += position;
+    const uint32_t strings[] = {record.from_type, record.to_type, record.context,
+                                record.time_typedef};
+    for (uint32_t id : strings) {
+        std::string text(id == NO_STRING ? "" : g_strings.get(id));
+        std::replace(text.begin(), text.end(), '\t', ' ');
+        fingerprint.findings += '\t' + text;
+    }
+}
+
+// Reports the findings of the unit, then releases their storage in bulk.
+static void flush_findings() {
+    std::vector<macro_finding_group> macro_groups;
+    std::unordered_map<macro_group_key, size_t, macro_group_key_hash> macro_group_index;
+
+    std::vector<expanded_location> locs;
+    for (size_t i = 0; i < g_findings.size(); ++i) {
+        finding &record = g_findings[i];
+        expanded_location xloc = expand_location(record.loc);
+        record.file = xloc.file ? g_strings.intern(xloc.file) : NO_STRING;
+        record.line = xloc.line;
+        record.column = xloc.column;
+        if (record.kind == FINDING_CONVERSION) locs.push_back(xloc);
+    }
+    prefetch_suppressions(locs);
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < g_findings.size(); ++i) {
+        finding &record = g_findings[i];
+        if (record.kind == FINDING_CONVERSION && record.file != NO_STRING &&
+            is_suppressed(g_strings.get(record.file), record.line)) {
+            continue;
+        }
+        order.push_back(i);
+    }
+    assign_execution_counts(order);
+    std::sort(order.begin(), order.end(), finding_order());
+
+    for (size_t i : order) {
+        const finding &record = g_findings[i];
+        if (record.kind == FINDING_TRUNCATED) {
+            add_report_line(record.loc, "narrowing analysis of '%s' truncated after %u nodes",
+                            g_strings.get(record.context), record.count);
+            warning_at(record.loc, 0, "narrowing analysis of %qs truncated after %u nodes",
+                       g_strings.get(record.context), record.count);
+            continue;
+        }
+        if (record.kind == FINDING_BUDGET_SKIPPED) {
+            add_report_line(record.loc,
+                            "narrowing analysis time budget exhausted; %u function(s) not "
+                            "analyzed",
+                            record.count);
+            warning_at(record.loc, 0,
+                       "narrowing analysis time budget exhausted; %u function(s) not analyzed",
+                       record.count);
+            continue;
+        }
+        char time_tag[128];
+        char message[1024];
+        const conversion_rule &rule = conversion_rules[record.rule];
+        snprintf(message, sizeof(message), "%s: %s from %s to %s in %s%s", rule.label,
+                 rule.summary, g_strings.get(record.from_type), g_strings.get(record.to_type),
+                 g_strings.get(record.context), get_time_tag(record, time_tag, sizeof(time_tag)));
+        if (record.function != NO_FUNCTION) add_fingerprint_finding(record);
+
+        if (g_options.macro_aggregate &&
+            linemap_location_from_macro_expansion_p(line_table, record.loc)) {
+            location_t def_loc = linemap_resolve_location(
+                line_table, record.loc, LRK_MACRO_DEFINITION_LOCATION, NULL);
+            macro_group_key key = {def_loc, record.from_type, record.to_type, record.context};
+            auto inserted = macro_group_index.emplace(key, macro_groups.size());
+            if (inserted.second) {
+                const line_map_macro *map =
+                    linemap_check_macro(linemap_lookup(line_table, record.loc));
+                macro_finding_group group;
+                group.first = i;
+                group.def_loc = def_loc;
+                group.macro_name = linemap_map_get_macro_name(map);
+                group.uses = 0;
+                macro_groups.push_back(group);
+            }
+
+            macro_finding_group &group = macro_groups[inserted.first->second];
+            group.uses++;
+            if (group.samples.size() < g_options.macro_samples) {
+                group.samples.push_back(linemap_resolve_location(
+                    line_table, record.loc, LRK_MACRO_EXPANSION_POINT, NULL));
+            }
+            continue;
+        }
+
+        char count_tag[64];
+        get_count_tag(record, count_tag, sizeof(count_tag));
+        add_report_line(record.loc, "%s%s", message, count_tag);
+        warning_at(record.loc, 0, "%s: %s from %s to %s in %s%s%s", rule.label, rule.summary,
+                   g_strings.get(record.from_type), g_strings.get(record.to_type),
+                   g_strings.get(record.context), time_tag, count_tag);
+    }
+    report_macro_groups(macro_groups);
+
+    g_findings.release();
+    g_strings.release();
+    g_finding_keys.clear();
+}
+
+// Lossy stores into one struct field, aggregated over the unit.
+struct field_store_stats {
+    tree field;
+    unsigned count;
+    location_t first_loc;
+    tree from_type;
+    tree to_type;
+    int rule;  // Rule of the first lossy store.
+};
+
+// Per-field statistics in order of first lossy store, and their index.
+static std::vector<field_store_stats> g_field_stores;
+static std::unordered_map<tree, unsigned> g_field_store_index;
+
+// Helper to get the FIELD_DECL a store destination writes, if any.
+static tree get_store_field(tree dest) {
+    if (!dest) return NULL_TREE;
+    if (TREE_CODE(dest) == FIELD_DECL) return dest;
+    if (TREE_CODE(dest) == COMPONENT_REF && TREE_CODE(TREE_OPERAND(dest, 1)) == FIELD_DECL) {
+        return TREE_OPERAND(dest, 1);
+    }
+    return NULL_TREE;
+}
+
+// Counts a lossy store into a struct field instead of reporting it.
+static void record_field_store(tree field, location_t loc, tree from_type, tree to_type,
+                               int rule) {
+    auto inserted = g_field_store_index.emplace(field, g_field_stores.size());
+    if (inserted.second) {
+        field_store_stats stats;
+        stats.field = field;
+        stats.count = 0;
+        stats.first_loc = loc;
+        stats.from_type = from_type;
+        stats.to_type = to_type;
+        stats.rule = rule;
+        g_field_stores.push_back(stats);
+    }
+    g_field_stores[inserted.first->second].count++;
+}
+
+// Reports each struct field that received lossy stores once, at its declaration.
+static void report_field_stores() {
+    std::sort(g_field_stores.begin(), g_field_stores.end(),
+              [](const field_store_stats &a, const field_store_stats &b) {
+                  expanded_location xa = expand_location(DECL_SOURCE_LOCATION(a.field));
+                  expanded_location xb = expand_location(DECL_SOURCE_LOCATION(b.field));
+                  int cmp = strcmp(xa.file ? xa.file : "", xb.file ? xb.file : "");
+                  if (cmp) return cmp < 0;
+                  if (xa.line != xb.line) return xa.line < xb.line;
+                  return xa.column < xb.column;
+              });
+
+    std::vector<expanded_location> locs;
+    for (const field_store_stats &stats : g_field_stores) {
+        locs.push_back(expand_location(DECL_SOURCE_LOCATION(stats.field)));
+    }
+    prefetch_suppressions(locs);
+
+    for (const field_store_stats &stats : g_field_stores) {
+        expanded_location xloc = expand_location(DECL_SOURCE_LOCATION(stats.field));
+        if (xloc.file && is_suppressed(xloc.file, xloc.line)) continue;
+        const conversion_rule &rule = conversion_rules[stats.rule];
+        add_report_line(DECL_SOURCE_LOCATION(stats.field),
+                        "%s: field '%s' of '%s' receives %u lossy store(s) from %s to %s",
+                        rule.label,
+                        DECL_NAME(stats.field) ? IDENTIFIER_POINTER(DECL_NAME(stats.field)) : "",
+                        get_type_name(DECL_CONTEXT(stats.field)), stats.count,
+                        get_type_name(stats.from_type), get_type_name(stats.to_type));
+        if (warning_at(DECL_SOURCE_LOCATION(stats.field), 0,
+                       "%s: field %qD of %qT receives %u lossy store(s) from %s to %s",
+                       rule.label, stats.field, DECL_CONTEXT(stats.field), stats.count,
+                       get_type_name(stats.from_type), get_type_name(stats.to_type))) {
+            inform(stats.first_loc, "first lossy store is here");
+        }
+    }
+    g_field_stores.clear();
+    g_field_store_index.clear();
+}
+
+// Conversions evaluated against the rules.
+static unsigned g_conversions_checked;
+
+// The core logic to detect narrowing conversion.
+static void check_narrowing_conversion(location_t loc, tree to_type, tree from_expr, tree dest,
+                                       conversion_context context_kind, const char *context,
+                                       const walk_data *data) {
+    tree from_type = get_original_type(from_expr);
+
+    if (!to_type || !from_type || to_type == error_mark_node || from_type == error_mark_node) {
+        return;
+    }
+
+    type_desc to = get_type_desc(to_type);
+    type_desc from = get_type_desc(from_type);
+    if (g_time_sources_only && !from.is_time) return;
+    g_conversions_checked++;
+
+    DEBUG_PRINT("Checking conversion in %s...\n", context);
+    DEBUG_PRINT("  To  : %s (precision: %u)\n", get_type_name(to_type), to.precision);
+    DEBUG_PRINT("  From: %s (precision: %u)\n", get_type_name(from_type), from.precision);
+
+    int rule = match_rule(context_kind, from, to);
+    if (rule < 0) return;
+
+    // Only conversions a rule reports get their source evaluated. Variadic
+    // arguments are passed at their type's width whatever the value.
+    if (g_options.value_ranges && context_kind != CONTEXT_FORMAT &&
+        from.kind == TYPE_KIND_INTEGER && to.kind == TYPE_KIND_INTEGER &&
+        from.precision > to.precision && value_range_fits(from_expr, to_type)) {
+        DEBUG_PRINT("  source value fits the target type, not reporting.\n");
+        g_range_suppressed++;
+        return;
+    }
+
+    uint64_t param_deps = 0;
+    if (g_options.taint && conversion_rules[rule].time_taint &&
+        !expr_is_time_tainted(from_expr, data, &param_deps)) {
+        DEBUG_PRINT("  narrowing of untainted value, not reporting.\n");
+        if (data->taint) data->taint->param_sinks |= param_deps;
+        return;
+    }
+    DEBUG_PRINT("  >>> POTENTIALLY DANGEROUS CAST DETECTED <<<\n");
+    tree field = g_options.field_report ? get_store_field(dest) : NULL_TREE;
+    if (field) {
+        record_field_store(field, loc, from_type, to_type, rule);
+        return;
+    }
+    record_finding(loc, from_type, to_type, context, rule);
+}
+
+// Helper function to reliably get the FUNCTION_DECL from a callee expression.
+static tree get_fndecl_from_callee_expr(tree callee) {
+    if (!callee) return NULL_TREE;
+
+    DEBUG_PRINT("  get_fndecl_from_callee_expr on: %s\n", get_tree_code_name(TREE_CODE(callee)));
+    // Peel back layers until we find the FUNCTION_DECL or can't go further.
+    while (callee) {
+        if (TREE_CODE(callee) == FUNCTION_DECL) {
+            return callee;
+        }
+        if (TREE_CODE(callee) == ADDR_EXPR || TREE_CODE(callee) == NOP_EXPR ||
+            TREE_CODE(callee) == CONVERT_EXPR) {
+            callee = TREE_OPERAND(callee, 0);
+        } else {
+            // Can't unwrap further.
+            return NULL_TREE;
+        }
+    }
+    return NULL_TREE;
+}
+
+// ======================= Known time APIs ========================
+
+// How a known library function carries time values. Argument masks have bit
+// N-1 set for argument N.
+struct known_api {
+    unsigned flags;
+    unsigned time_in_args;   // Arguments read as times, by value or through a pointer.
+    unsigned time_out_args;  // Pointer arguments through which a time is stored.
+};
+enum {
+    KNOWN_API_RETURNS_TIME = 1 << 0,  // The return value is a time.
+    KNOWN_API_SERIALIZES = 1 << 1,    // Arguments are written to a fixed-width record.
+};
+#define API_ARG(n) (1u << ((n) - 1))
+
+struct known_api_entry {
+    const char *name;
+    known_api api;
+};
+
+// Built-in table of libc and POSIX functions that produce, consume or
+// serialize time values. Extend it with known-apis=<file>.
+static const known_api_entry builtin_known_apis[] = {
+    {"time", {KNOWN_API_RETURNS_TIME, 0, API_ARG(1)}},
+    {"mktime", {KNOWN_API_RETURNS_TIME, 0, 0}},
+    {"timegm", {KNOWN_API_RETURNS_TIME, 0, 0}},
+    {"timelocal", {KNOWN_API_RETURNS_TIME, 0, 0}},
+    {"difftime", {KNOWN_API_RETURNS_TIME, API_ARG(1) | API_ARG(2), 0}},
+    {"clock_gettime", {0, 0, API_ARG(2)}},
+    {"clock_getres", {0, 0, API_ARG(2)}},
+    {"clock_settime", {0, API_ARG(2), 0}},
+    {"timespec_get", {0, 0, API_ARG(1)}},
+    {"gettimeofday", {0, 0, API_ARG(1)}},
+    {"settimeofday", {0, API_ARG(1), 0}},
+    {"stime", {0, API_ARG(1), 0}},
+    {"localtime", {0, API_ARG(1), 0}},
+    {"localtime_r", {0, API_ARG(1), 0}},
+    {"gmtime", {0, API_ARG(1), 0}},
+    {"gmtime_r", {0, API_ARG(1), 0}},
+    {"ctime", {0, API_ARG(1), 0}},
+    {"ctime_r", {0, API_ARG(1), 0}},
+    {"nanosleep", {0, API_ARG(1), 0}},
+    {"stat", {0, 0, API_ARG(2)}},
+    {"fstat", {0, 0, API_ARG(2)}},
+    {"lstat", {0, 0, API_ARG(2)}},
+    {"fstatat", {0, 0, API_ARG(3)}},
+    {"utime", {0, API_ARG(2), 0}},
+    {"utimes", {0, API_ARG(2), 0}},
+    {"utimensat", {0, API_ARG(3), 0}},
+    {"futimens", {0, API_ARG(2), 0}},
+    {"htonl", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"htobe32", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"htole32", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"fwrite", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"write", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"pwrite", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"send", {KNOWN_API_SERIALIZES, 0, 0}},
+    {"sendto", {KNOWN_API_SERIALIZES, 0, 0}},
+};
+
+// Known APIs keyed by IDENTIFIER_NODE. Identifiers are unique per spelling,
+// so classifying a callee is one pointer-keyed lookup with no string compares.
+static std::unordered_map<tree, known_api> g_known_apis;
+
+// Parses one "name [returns] [serializes] [in=N,...] [out=N,...]" line of a
+// known-APIs file. Returns false if the line is malformed.
+static bool parse_known_api_line(char *line, known_api_entry *entry) {
+    char *save = NULL;
+    char *name = strtok_r(line, " \t\r\n", &save);
+    if (!name) return false;
+
+    entry->name = name;
+    entry->api.flags = 0;
+    entry->api.time_in_args = 0;
+    entry->api.time_out_args = 0;
+    for (char *word = strtok_r(NULL, " \t\r\n", &save); word;
+         word = strtok_r(NULL, " \t\r\n", &save)) {
+        unsigned *mask = NULL;
+        if (strcmp(word, "returns") == 0) {
+            entry->api.flags |= KNOWN_API_RETURNS_TIME;
+        } else if (strcmp(word, "serializes") == 0) {
+            entry->api.flags |= KNOWN_API_SERIALIZES;
+        } else if (strncmp(word, "in=", 3) == 0) {
+            mask = &entry->api.time_in_args;
+        } else if (strncmp(word, "out=", 4) == 0) {
+            mask = &entry->api.time_out_args;
+        } else {
+            return false;
+        }
+
+        for (char *arg = mask ? strchr(word, '=') : NULL; arg && *arg; arg = strchr(arg, ',')) {
+            long n = strtol(arg + 1, &arg, 10);
+            if (n < 1 || n > 32) return false;
+            *mask |= API_ARG(n);
+        }
+    }
+    return true;
+}
+
+// Adds the entries of a user-supplied known-APIs file to the table. Lines
+// starting with '#' are comments.
+static void load_known_apis_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        error("narrowing_cast_plugin: cannot open known-APIs file %qs", path);
+        return;
+    }
+
+    char line[512];
+    for (int line_num = 1; fgets(line, sizeof(line), file); ++line_num) {
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') continue;
+
+        known_api_entry entry;
+        if (!parse_known_api_line(start, &entry)) {
+            warning(0, "narrowing_cast_plugin: %s:%d: malformed known-API entry", path, line_num);
+            continue;
+        }
+        g_known_apis[get_identifier(entry.name)] = entry.api;
+    }
+    fclose(file);
+}
+
+// Adds the known-API lines held by the daemon; false if it could not be asked.
+static bool load_known_apis_from_daemon() {
+    std::string line;
+    if (!daemon_request("APIS", &line)) return false;
+    while (line != ".") {
+        known_api_entry entry;
+        if (parse_known_api_line(&line[0], &entry)) {
+            g_known_apis[get_identifier(entry.name)] = entry.api;
+        }
+        if (!daemon_read_line(&line)) return false;
+    }
+    return true;
+}
+
+// Resolves the built-in table, plus the user entries from the daemon or an
+// optional file, to identifiers.
+static void init_known_apis(const char *user_file) {
+    for (const known_api_entry &entry : builtin_known_apis) {
+        g_known_apis[get_identifier(entry.name)] = entry.api;
+    }
+    if (g_daemon_fd >= 0 && load_known_apis_from_daemon()) return;
+    if (user_file) {
+        load_known_apis_file(user_file);
+    }
+}
+
+// Helper to find the known-API description of a called function, if any.
+static const known_api *lookup_known_api(tree fndecl) {
+    if (!fndecl || !DECL_NAME(fndecl) || !DECL_EXTERN_C_P(fndecl)) return NULL;
+
+    auto it = g_known_apis.find(DECL_NAME(fndecl));
+    return it == g_known_apis.end() ? NULL : &it->second;
+}
+
+// ===================== Time-taint tracking =====================
+
+// Returns the dense taint index of a local or parameter, or -1 if untracked.
+static int taint_index(const taint_state *taint, tree decl) {
+    auto it = taint->local_index.find(decl);
+    return it == taint->local_index.end() ? -1 : (int)it->second;
+}
+
+// Decides whether an expression carries a value derived from a time source.
+// If param_deps is given, the inputs the value may derive from are added to
+// it, which requires visiting every operand instead of stopping early.
+static bool expr_is_time_tainted(tree expr, const walk_data *data, uint64_t *param_deps) {
+    bool tainted = false;
+    while (expr && !(tainted && !param_deps)) {
+        if (TREE_TYPE(expr) && get_type_desc(TREE_TYPE(expr)).is_time) return true;
+
+        switch (TREE_CODE(expr)) {
+            case VAR_DECL:
+            case PARM_DECL: {
+                int index = data->taint ? taint_index(data->taint, expr) : -1;
+                if (index < 0) return tainted;
+                if (param_deps) *param_deps |= data->taint->param_deps[index];
+                return tainted || bitmap_bit_p(data->taint->tainted, index);
+            }
+            case CALL_EXPR: {
+                tree callee = get_fndecl_from_callee_expr(CALL_EXPR_FN(expr));
+                const known_api *api = lookup_known_api(callee);
+                if (api && (api->flags & KNOWN_API_RETURNS_TIME)) return true;
+                if (param_deps && data->taint) {
+                    auto slot = data->taint->call_slots.find(expr);
+                    if (slot != data->taint->call_slots.end()) {
+                        *param_deps |= CALL_INPUT(slot->second);
+                    }
+                }
+
+                auto it = callee ? g_taint_summaries.find(callee) : g_taint_summaries.end();
+                if (it == g_taint_summaries.end()) return tainted;
+                if (it->second.returns_time) return true;
+                for (int i = 0; i < call_expr_nargs(expr) && i < 32; ++i) {
+                    if (it->second.ret_deps & PARAM_INPUT(i)) {
+                        tainted |= expr_is_time_tainted(CALL_EXPR_ARG(expr, i), data, param_deps);
+                    }
+                }
+                return tainted;
+            }
+            case NOP_EXPR:
+            case CONVERT_EXPR:
+            case VIEW_CONVERT_EXPR:
+            case NON_LVALUE_EXPR:
+            case FLOAT_EXPR:
+            case FIX_TRUNC_EXPR:
+            case SAVE_EXPR:
+            case NEGATE_EXPR:
+            case ABS_EXPR:
+                expr = TREE_OPERAND(expr, 0);
+                break;
+            case COMPOUND_EXPR:
+            case MODIFY_EXPR:
+            case INIT_EXPR:
+                expr = TREE_OPERAND(expr, 1);
+                break;
+            case TARGET_EXPR:
+                expr = TARGET_EXPR_INITIAL(expr);
+                break;
+            case COND_EXPR:
+                tainted |= expr_is_time_tainted(TREE_OPERAND(expr, 1), data, param_deps);
+                expr = TREE_OPERAND(expr, 2);
+                break;
+            case PLUS_EXPR:
+            case MINUS_EXPR:
+            case MULT_EXPR:
+            case TRUNC_DIV_EXPR:
+            case RDIV_EXPR:
+            case TRUNC_MOD_EXPR:
+            case BIT_AND_EXPR:
+            case BIT_IOR_EXPR:
+            case BIT_XOR_EXPR:
+            case LSHIFT_EXPR:
+            case RSHIFT_EXPR:
+            case MIN_EXPR:
+            case MAX_EXPR:
+                tainted |= expr_is_time_tainted(TREE_OPERAND(expr, 0), data, param_deps);
+                expr = TREE_OPERAND(expr, 1);
+                break;
+            default:
+                return tainted;
+        }
+    }
+    return tainted;
+}
+
+// Marks the local underlying a store destination as tainted and as depending
+// on the given parameters. Returns true if this changed the taint state.
+static bool mark_time_tainted(taint_state *taint, tree dest, bool tainted, uint64_t param_deps) {
+    while (dest && (TREE_CODE(dest) == COMPONENT_REF || TREE_CODE(dest) == ARRAY_REF ||
+                    TREE_CODE(dest) == NOP_EXPR)) {
+        dest = TREE_OPERAND(dest, 0);
+    }
+
+    int index = dest ? taint_index(taint, dest) : -1;
+    if (index < 0) return false;
+
+    bool changed = false;
+    if (tainted && !bitmap_bit_p(taint->tainted, index)) {
+        bitmap_set_bit(taint->tainted, index);
+        changed = true;
+    }
+    if (param_deps & ~taint->param_deps[index]) {
+        taint->param_deps[index] |= param_deps;
+        changed = true;
+    }
+    return changed;
+}
+
+// walk_tree callback numbering the locals of the function being analyzed and
+// the calls whose results the IPA pass may find time-derived.
+static tree collect_taint_locals(tree *tp, int *walk_subtrees, void *user_data) {
+    (void)walk_subtrees;
+    walk_data *data = (walk_data *)user_data;
+    taint_state *taint = data->taint;
+    tree node = *tp;
+    if (walk_budget_exceeded(data)) return node;
+    if (TREE_CODE(node) == VAR_DECL && DECL_CONTEXT(node) == taint->fndecl) {
+        taint->local_index.emplace(node, taint->local_index.size());
+    } else if (TREE_CODE(node) == CALL_EXPR && taint->call_slots.size() < 32) {
+        tree callee = get_fndecl_from_callee_expr(CALL_EXPR_FN(node));
+        if (callee && !fndecl_built_in_p(callee) && !lookup_known_api(callee)) {
+            taint->call_slots.emplace(node, taint->call_slots.size());
+        }
+    }
+    return NULL_TREE;
+}
+
+// State shared by one propagation sweep over a function body.
+struct taint_sweep {
+    walk_data *data;
+    bool changed;
+};
+
+// walk_tree callback propagating taint through stores and time-source calls.
+static tree propagate_time_taint(tree *tp, int *walk_subtrees, void *user_data) {
+    (void)walk_subtrees;
+    taint_sweep *sweep = (taint_sweep *)user_data;
+    tree node = *tp;
+    if (walk_budget_exceeded(sweep->data)) return node;
+
+    switch (TREE_CODE(node)) {
+        case MODIFY_EXPR:
+        case INIT_EXPR: {
+            uint64_t param_deps = 0;
+            bool tainted = expr_is_time_tainted(TREE_OPERAND(node, 1), sweep->data, &param_deps);
+            if (tainted || param_deps) {
+                sweep->changed |= mark_time_tainted(sweep->data->taint, TREE_OPERAND(node, 0),
+                                                    tainted, param_deps);
+            }
+            break;
+        }
+        case CALL_EXPR: {
+            // Arguments a time API reads or writes as times hold time values,
+            // whether passed by value or by address.
+            const known_api *api =
+                lookup_known_api(get_fndecl_from_callee_expr(CALL_EXPR_FN(node)));
+            unsigned time_args = api ? api->time_in_args | api->time_out_args : 0;
+            for (int i = 0; time_args && i < call_expr_nargs(node) && i < 32; ++i) {
+                if (!(time_args & (1u << i))) continue;
+                tree arg = CALL_EXPR_ARG(node, i);
+                STRIP_NOPS(arg);
+                if (TREE_CODE(arg) == ADDR_EXPR) arg = TREE_OPERAND(arg, 0);
+                sweep->changed |= mark_time_tainted(sweep->data->taint, arg, true, 0);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return NULL_TREE;
+}
+
+// Computes the set of time-tainted locals of a function. GENERIC has no SSA
+// form yet, so this is a flow-insensitive fixed point over the body's stores,
+// which is what SSA would give for the single-assignment locals that carry
+// time values in practice. Every sweep is charged to the function's budget.
+static void compute_time_taint(tree fndecl, tree body, walk_data *data, taint_state *taint) {
+    taint->fndecl = fndecl;
+    taint->param_sinks = 0;
+    for (tree parm = DECL_ARGUMENTS(fndecl); parm; parm = DECL_CHAIN(parm)) {
+        taint->local_index.emplace(parm, taint->local_index.size());
+    }
+    unsigned num_params = taint->local_index.size();
+    data->taint = taint;
+    walk_tree_without_duplicates(&body, collect_taint_locals, data);
+
+    taint->tainted = sbitmap_alloc(taint->local_index.size() + 1);
+    bitmap_clear(taint->tainted);
+    taint->param_deps.assign(taint->local_index.size(), 0);
+    for (unsigned i = 0; i < num_params && i < 32; ++i) {
+        taint->param_deps[i] = PARAM_INPUT(i);
+    }
+
+    taint_sweep sweep;
+    sweep.data = data;
+    do {
+        sweep.changed = false;
+        walk_tree_without_duplicates(&body, propagate_time_taint, &sweep);
+    } while (sweep.changed && !data->truncated);
+
+    DEBUG_PRINT("  time taint: %u tracked locals\n", (unsigned)taint->local_index.size());
+}
+
+// State shared by the walk that builds a function's interprocedural summary.
+struct summary_sweep {
+    walk_data *data;
+    time_taint_summary summary;
+    tree calls;  // TREE_LIST of (callee FUNCTION_DECL, TREE_VEC of argument masks).
+};
+
+// walk_tree callback collecting the return and call-site facts of a summary.
+// Each call record's TREE_VEC holds the mask of arguments that are locally
+// time-derived, the call's input slot or -1, and then the input-dependency
+// mask of every argument.
+static tree collect_taint_summary(tree *tp, int *walk_subtrees, void *user_data) {
+    (void)walk_subtrees;
+    summary_sweep *sweep = (summary_sweep *)user_data;
+    tree node = *tp;
+
+    if (TREE_CODE(node) == RETURN_EXPR && TREE_OPERAND(node, 0)) {
+        uint64_t param_deps = 0;
+        if (expr_is_time_tainted(TREE_OPERAND(node, 0), sweep->data, &param_deps)) {
+            sweep->summary.returns_time = true;
+        }
+        sweep->summary.ret_deps |= param_deps;
+    } else if (TREE_CODE(node) == CALL_EXPR) {
+        tree callee = get_fndecl_from_callee_expr(CALL_EXPR_FN(node));
+        if (!callee || fndecl_built_in_p(callee)) return NULL_TREE;
+
+        auto slot = sweep->data->taint->call_slots.find(node);
+        bool has_slot = slot != sweep->data->taint->call_slots.end();
+        int nargs = MIN(call_expr_nargs(node), 32);
+        tree vec = make_tree_vec(nargs + 2);
+        unsigned tainted_args = 0;
+        bool interesting = has_slot;
+        for (int i = 0; i < nargs; ++i) {
+            uint64_t param_deps = 0;
+            if (expr_is_time_tainted(CALL_EXPR_ARG(node, i), sweep->data, &param_deps)) {
+                tainted_args |= 1u << i;
+            }
+            interesting |= param_deps != 0;
+            TREE_VEC_ELT(vec, i + 2) = build_int_cstu(long_long_unsigned_type_node, param_deps);
+        }
+        if (!tainted_args && !interesting) return NULL_TREE;
+
+        TREE_VEC_ELT(vec, 0) = build_int_cst(unsigned_type_node, tainted_args);
+        TREE_VEC_ELT(vec, 1) = build_int_cst(integer_type_node, has_slot ? (int)slot->second : -1);
+        sweep->calls = tree_cons(callee, vec, sweep->calls);
+    }
+    return NULL_TREE;
+}
+
+// Records the interprocedural summary of a function after its traversal, both
+// for callers later in this unit and, as an attribute, for the IPA pass.
+static void record_taint_summary(tree fndecl, tree body, walk_data *data) {
+    summary_sweep sweep;
+    sweep.data = data;
+    sweep.summary.returns_time = false;
+    sweep.summary.ret_deps = 0;
+    sweep.summary.param_sinks = data->taint->param_sinks;
+    sweep.calls = NULL_TREE;
+    walk_tree_without_duplicates(&body, collect_taint_summary, &sweep);
+
+    g_taint_summaries[fndecl] = sweep.summary;
+
+    tree value = tree_cons(
+        NULL_TREE, build_int_cstu(long_long_unsigned_type_node, sweep.summary.param_sinks),
+        sweep.calls);
+    value = tree_cons(NULL_TREE,
+                      build_int_cstu(long_long_unsigned_type_node, sweep.summary.ret_deps), value);
+    value = tree_cons(NULL_TREE, build_int_cst(unsigned_type_node, sweep.summary.returns_time),
+                      value);
+    DECL_ATTRIBUTES(fndecl) =
+        tree_cons(get_identifier(TIME_TAINT_ATTR), value, DECL_ATTRIBUTES(fndecl));
+}
+
+// Whole-program view of one summarized function during the IPA pass.
+struct ipa_taint_node {
+    tree decl;
+    bool returns_time;
+    uint64_t ret_deps;
+    uint64_t param_sinks;
+    uint64_t tainted;  // Inputs found time-derived: parameters and call results.
+    tree calls;
+};
+
+// Helper to find the callee of the call with an input slot in a call list.
+static tree get_slot_callee(tree calls, int slot) {
+    for (tree call = calls; call; call = TREE_CHAIN(call)) {
+        if (tree_to_shwi(TREE_VEC_ELT(TREE_VALUE(call), 1)) == slot) return TREE_PURPOSE(call);
+    }
+    return NULL_TREE;
+}
+
+// IPA pass propagating time taint from call sites into callee parameters, and
+// from callee return values back into the callers' call results. In
+// an LTO build it runs at WPA over the summaries streamed with every unit's
+// declarations; the per-function analysis that produced them already ran in
+// parallel in the compile jobs, so the only serial work is this fixed point.
+const pass_data pass_data_ipa_time_taint = {
+    IPA_PASS,       /* type */
+    "y2038_taint",  /* name */
+    OPTGROUP_NONE,  /* optinfo_flags */
+    TV_NONE,        /* tv_id */
+    0,              /* properties_required */
+    0,              /* properties_provided */
+    0,              /* properties_destroyed */
+    0,              /* todo_flags_start */
+    0,              /* todo_flags_finish */
+};
+
+class pass_ipa_time_taint : public ipa_opt_pass_d {
+public:
+    pass_ipa_time_taint(gcc::context *ctxt)
+        : ipa_opt_pass_d(pass_data_ipa_time_taint, ctxt,
+                         NULL, /* generate_summary */
+                         NULL, /* write_summary */
+                         NULL, /* read_summary */
+                         NULL, /* write_optimization_summary */
+                         NULL, /* read_optimization_summary */
+                         NULL, /* stmt_fixup */
+                         0,    /* function_transform_todo_flags_start */
+                         NULL, /* function_transform */
+                         NULL) /* variable_transform */ {}
+
+    virtual bool gate(function *) { return g_options.taint; }
+    virtual unsigned int execute(function *);
+};
+
+unsigned int pass_ipa_time_taint::execute(function *) {
+    std::vector<ipa_taint_node> nodes;
+    std::unordered_map<tree, unsigned> node_index;
+
+    cgraph_node *node;
+    FOR_EACH_FUNCTION(node) {
+        tree attr = lookup_attribute(TIME_TAINT_ATTR, DECL_ATTRIBUTES(node->decl));
+        if (!attr) continue;
+
+        tree value = TREE_VALUE(attr);
+        ipa_taint_node entry;
+        entry.decl = node->decl;
+        entry.returns_time = !integer_zerop(TREE_VALUE(value));
+        entry.ret_deps = TREE_INT_CST_LOW(TREE_VALUE(TREE_CHAIN(value)));
+        entry.param_sinks = TREE_INT_CST_LOW(TREE_VALUE(TREE_CHAIN(TREE_CHAIN(value))));
+        entry.tainted = 0;
+        entry.calls = TREE_CHAIN(TREE_CHAIN(TREE_CHAIN(value)));
+        node_index[node->decl] = nodes.size();
+        nodes.push_back(entry);
+    }
+
+    // Inputs only gain taint, so this terminates after at most
+    // 64 * nodes.size() rounds; in practice a handful.
+    bool changed;
+    do {
+        changed = false;
+        for (ipa_taint_node &caller : nodes) {
+            for (tree call = caller.calls; call; call = TREE_CHAIN(call)) {
+                tree callee = TREE_PURPOSE(call);
+                cgraph_node *callee_node = cgraph_node::get(callee);
+                if (callee_node) callee = callee_node->ultimate_alias_target()->decl;
+
+                auto it = node_index.find(callee);
+                if (it == node_index.end()) continue;
+
+                tree vec = TREE_VALUE(call);
+                uint64_t args = TREE_INT_CST_LOW(TREE_VEC_ELT(vec, 0));
+                for (int i = 2; i < TREE_VEC_LENGTH(vec); ++i) {
+                    if (TREE_INT_CST_LOW(TREE_VEC_ELT(vec, i)) & caller.tainted) {
+                        args |= PARAM_INPUT(i - 2);
+                    }
+                }
+
+                ipa_taint_node &target = nodes[it->second];
+                if (args & ~target.tainted) {
+                    target.tainted |= args;
+                    changed = true;
+                }
+
+                // The call's result is time-derived if the callee returns time
+                // data of its own or passes a tainted argument through.
+                HOST_WIDE_INT slot = tree_to_shwi(TREE_VEC_ELT(vec, 1));
+                bool returns_time = target.returns_time ||
+                                    (target.ret_deps & ~PARAM_INPUTS & target.tainted) ||
+                                    (target.ret_deps & args);
+                if (slot >= 0 && returns_time && !(caller.tainted & CALL_INPUT(slot))) {
+                    caller.tainted |= CALL_INPUT(slot);
+                    changed = true;
+                }
+            }
+        }
+    } while (changed);
+
+    for (const ipa_taint_node &entry : nodes) {
+        uint64_t narrowed = entry.param_sinks & entry.tainted;
+        for (int i = 0; i < 32; ++i) {
+            if (narrowed & PARAM_INPUT(i)) {
+                warning_at(DECL_SOURCE_LOCATION(entry.decl), 0,
+                           "Y2038 potential issue: parameter %d of %qD receives time-derived "
+                           "values from its callers and is narrowed",
+                           i + 1, entry.decl);
+            }
+        }
+        for (int slot = 0; slot < 32; ++slot) {
+            tree callee = narrowed & CALL_INPUT(slot) ? get_slot_callee(entry.calls, slot) : NULL;
+            if (callee) {
+                warning_at(DECL_SOURCE_LOCATION(entry.decl), 0,
+                           "Y2038 potential issue: %qD narrows the time-derived value returned "
+                           "by %qD",
+                           entry.decl, callee);
+            }
+        }
+    }
+    return 0;
+}
+
+// ===================== Runtime checks =====================
+
+// With the instrument option, narrowing integer casts on the lines of
+// reported conversions get a call into narrowing_cast_rt.c that reports
+// values out of the target's range. Each site is checked on every
+// execution, on one execution in a power-of-two period, or not at all, so
+// that the checks the profile predicts stay within check-budget; the
+// coldest sites are fully checked first. Sites are planned once for the
+// whole unit, when the pass first runs and every function still has its
+// GIMPLE body, and then instrumented function by function.
+
+// Plan of one check site: its statement, its profile count and its period,
+// where 1 is a full check and 0 none.
+struct check_site {
+    gimple *stmt;
+    int64_t count;  // -1 without a profile.
+    unsigned period;
+};
+
+// Orders check sites from the coldest.
+struct check_site_order {
+    bool operator()(const check_site &a, const check_site &b) const { return a.count < b.count; }
+};
+
+static bool g_check_sites_planned;
+static std::unordered_map<gimple *, unsigned> g_check_periods;
+static std::unordered_set<uint64_t> g_check_lines;  // Lines of reported conversions.
+
+// Totals over the planned sites, for the end of unit report.
+static unsigned g_check_sites_full;
+static unsigned g_check_sites_sampled;
+static unsigned g_check_sites_unchecked;
+static double g_expected_checks;
+static bool g_check_profile;
+
+// __narrowing_cast_check_s and __narrowing_cast_check_u, built on first use.
+static tree g_check_fns[2];
+static const struct ggc_root_tab check_fns_root_tab[] = {
+    {&g_check_fns[0], 2, sizeof(g_check_fns[0]), &gt_ggc_mx_tree_node, &gt_pch_nx_tree_node},
+    LAST_GGC_ROOT_TAB,
+};
+
+// Helper to get the runtime check function for signed or unsigned values.
+static tree get_check_fn(bool is_unsigned) {
+    tree &fn = g_check_fns[is_unsigned];
+    if (!fn) {
+        tree value_type = is_unsigned ? long_long_unsigned_type_node : long_long_integer_type_node;
+        // Not const_string_type_node: it lives in c_global_trees, which lto1 lacks.
+        tree site_type = build_pointer_type(build_qualified_type(char_type_node, TYPE_QUAL_CONST));
+        tree fntype = build_function_type_list(void_type_node, value_type, value_type, value_type,
+                                               site_type, unsigned_type_node, NULL_TREE);
+        fn = build_fn_decl(is_unsigned ? "__narrowing_cast_check_u" : "__narrowing_cast_check_s",
+                           fntype);
+        TREE_NOTHROW(fn) = 1;
+    }
+    return fn;
+}
+
+// Whether a statement is an integer cast to a narrower type that can be checked.
+static bool is_checkable_cast(gimple *stmt) {
+    if (!is_gimple_assign(stmt) || !CONVERT_EXPR_CODE_P(gimple_assign_rhs_code(stmt))) {
+        return false;
+    }
+    tree value = gimple_assign_rhs1(stmt);
+    tree to_type = TREE_TYPE(gimple_assign_lhs(stmt));
+    tree from_type = TREE_TYPE(value);
+    return TREE_CODE(value) == SSA_NAME && TREE_CODE(to_type) == INTEGER_TYPE &&
+           TREE_CODE(from_type) == INTEGER_TYPE &&
+           TYPE_PRECISION(to_type) < TYPE_PRECISION(from_type) && TYPE_PRECISION(from_type) <= 64;
+}
+
+// Helper to key a source line by its interned file name.
+static uint64_t get_line_key(const expanded_location &xloc) {
+    return (uint64_t)g_strings.intern(xloc.file) << 32 | (uint32_t)xloc.line;
+}
+
+// Chooses the period of every check site in the unit. Sites are visited from
+// the coldest, each taking a full check if its count fits its share of the
+// remaining budget, a sampled one otherwise, and none once it is spent.
+static void plan_check_sites() {
+    g_check_sites_planned = true;
+
+    std::vector<expanded_location> locs;
+    for (size_t i = 0; i < g_findings.size(); ++i) {
+        const finding &record = g_findings[i];
+        if (record.kind == FINDING_CONVERSION) locs.push_back(expand_location(record.loc));
+    }
+    prefetch_suppressions(locs);
+    for (const expanded_location &xloc : locs) {
+        if (!xloc.file || is_suppressed(xloc.file, xloc.line)) continue;
+        g_check_lines.insert(get_line_key(xloc));
+    }
+    if (g_check_lines.empty()) return;
+
+    std::vector<check_site> sites;
+    cgraph_node *node;
+    FOR_EACH_FUNCTION_WITH_GIMPLE_BODY(node) {
+        function *fn = DECL_STRUCT_FUNCTION(node->decl);
+        if (!fn || !fn->cfg) continue;
+
+        basic_block bb;
+        FOR_EACH_BB_FN(bb, fn) {
+            profile_count count = bb->count.ipa();
+            for (gimple_stmt_iterator gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+                gimple *stmt = gsi_stmt(gsi);
+                if (!is_checkable_cast(stmt)) continue;
+                expanded_location xloc = expand_location(gimple_location(stmt));
+                if (!xloc.file || !g_check_lines.count(get_line_key(xloc))) continue;
+
+                check_site site;
+                site.stmt = stmt;
+                site.count = count.initialized_p() ? count.to_gcov_type() : -1;
+                site.period = 1;
+                g_check_profile |= site.count >= 0;
+                sites.push_back(site);
+            }
+        }
+    }
+
+    if (g_options.check_budget && g_check_profile) {
+        std::stable_sort(sites.begin(), sites.end(), check_site_order());
+        double remaining = g_options.check_budget;
+        for (size_t i = 0; i < sites.size(); ++i) {
+            double share = remaining / (sites.size() - i);
+            double count = sites[i].count > 0 ? sites[i].count : 0;
+            if (count <= share) {
+                remaining -= count;
+                continue;
+            }
+
+            sites[i].period = 0;
+            if (share < 1) continue;
+            unsigned period = 2;
+            while (period < (1u << 30) && count / period > share) period <<= 1;
+            if (count / period <= share) {
+                sites[i].period = period;
+                remaining -= count / period;
+            }
+        }
+    }
+
+    for (const check_site &site : sites) {
+        g_check_periods[site.stmt] = site.period;
+        double count = site.count > 0 ? site.count : 0;
+        if (site.period == 1) {
+            g_check_sites_full++;
+            g_expected_checks += count;
+        } else if (site.period) {
+            g_check_sites_sampled++;
+            g_expected_checks += count / site.period;
+        } else {
+            g_check_sites_unchecked++;
+        }
+    }
+}
+
+// Helper to create the execution counter of a sampled site.
+static tree create_site_counter() {
+    tree counter = build_decl(UNKNOWN_LOCATION, VAR_DECL,
+                              create_tmp_var_name("__narrowing_cast_samples"), unsigned_type_node);
+    TREE_STATIC(counter) = 1;
+    TREE_USED(counter) = 1;
+    DECL_ARTIFICIAL(counter) = 1;
+    DECL_IGNORED_P(counter) = 1;
+    varpool_node::add(counter);
+    return counter;
+}
+
+// Whether a statement is still a planned cast. Statements can be replaced
+// between planning and the function's own pass, so the cast and its line are
+// checked again.
+static bool is_planned_cast(gimple *stmt) {
+    if (!is_checkable_cast(stmt)) return false;
+    expanded_location xloc = expand_location(gimple_location(stmt));
+    return xloc.file && g_check_lines.count(get_line_key(xloc));
+}
+
+// Inserts the runtime check of a cast. A sampled check counts the site's
+// executions and branches to the call on every period-th one.
+static void insert_check(gimple *stmt, unsigned period) {
+    tree value = gimple_assign_rhs1(stmt);
+    tree to_type = TREE_TYPE(gimple_assign_lhs(stmt));
+    bool is_unsigned = TYPE_UNSIGNED(TREE_TYPE(value));
+    tree value_type = is_unsigned ? long_long_unsigned_type_node : long_long_integer_type_node;
+    // The target is narrower than 64 bits, so its bounds fit a HOST_WIDE_INT.
+    HOST_WIDE_INT min = tree_to_shwi(TYPE_MIN_VALUE(to_type));
+    HOST_WIDE_INT max = tree_to_shwi(TYPE_MAX_VALUE(to_type));
+    if (is_unsigned && min < 0) min = 0;
+
+    expanded_location xloc = expand_location(gimple_location(stmt));
+    char site[1024];
+    snprintf(site, sizeof(site), "%s:%d", xloc.file ? xloc.file : "<unknown>", xloc.line);
+
+    gimple_seq check = NULL;
+    tree arg = make_ssa_name(value_type);
+    gimple_seq_add_stmt(&check, gimple_build_assign(arg, NOP_EXPR, value));
+    gcall *call = gimple_build_call(
+        get_check_fn(is_unsigned), 5, arg, build_int_cst(value_type, min),
+        build_int_cst(value_type, max), build_string_literal(strlen(site) + 1, site),
+        build_int_cst(unsigned_type_node, period));
+    gimple_set_location(call, gimple_location(stmt));
+    gimple_seq_add_stmt(&check, call);
+
+    gimple_stmt_iterator gsi = gsi_for_stmt(stmt);
+    if (period == 1) {
+        gsi_insert_seq_before(&gsi, check, GSI_SAME_STMT);
+        return;
+    }
+
+    tree counter = create_site_counter();
+    tree old_count = make_ssa_name(unsigned_type_node);
+    tree new_count = make_ssa_name(unsigned_type_node);
+    tree sample = make_ssa_name(unsigned_type_node);
+    gimple_seq head = NULL;
+    gimple_seq_add_stmt(&head, gimple_build_assign(old_count, counter));
+    gimple_seq_add_stmt(&head, gimple_build_assign(new_count, PLUS_EXPR, old_count,
+                                                   build_one_cst(unsigned_type_node)));
+    gimple_seq_add_stmt(&head, gimple_build_assign(counter, new_count));
+    gimple_seq_add_stmt(&head, gimple_build_assign(sample, BIT_AND_EXPR, new_count,
+                                                   build_int_cst(unsigned_type_node, period - 1)));
+    gcond *cond = gimple_build_cond(EQ_EXPR, sample, build_zero_cst(unsigned_type_node),
+                                    NULL_TREE, NULL_TREE);
+    gimple_seq_add_stmt(&head, cond);
+    gsi_insert_seq_before(&gsi, head, GSI_SAME_STMT);
+
+    basic_block bb = gimple_bb(cond);
+    edge skip = split_block(bb, cond);
+    basic_block check_bb = create_empty_bb(bb);
+    if (current_loops) add_bb_to_loop(check_bb, bb->loop_father);
+    gimple_stmt_iterator check_gsi = gsi_last_bb(check_bb);
+    gsi_insert_seq_after(&check_gsi, check, GSI_CONTINUE_LINKING);
+
+    edge take = make_edge(bb, check_bb, EDGE_TRUE_VALUE);
+    skip->flags = (skip->flags & ~EDGE_FALLTHRU) | EDGE_FALSE_VALUE;
+    make_single_succ_edge(check_bb, skip->dest, EDGE_FALLTHRU);
+    take->probability = profile_probability::always().apply_scale(1, period);
+    skip->probability = take->probability.invert();
+    check_bb->count = bb->count.apply_probability(take->probability);
+}
+
+const pass_data pass_data_runtime_checks = {
+    GIMPLE_PASS,         /* type */
+    "y2038_checks",      /* name */
+    OPTGROUP_NONE,       /* optinfo_flags */
+    TV_NONE,             /* tv_id */
+    PROP_cfg | PROP_ssa, /* properties_required */
+    0,                   /* properties_provided */
+    0,                   /* properties_destroyed */
+    0,                   /* todo_flags_start */
+    0,                   /* todo_flags_finish */
+};
+
+class pass_runtime_checks : public gimple_opt_pass {
+public:
+    pass_runtime_checks(gcc::context *ctxt) : gimple_opt_pass(pass_data_runtime_checks, ctxt) {}
+
+    virtual bool gate(function *) { return g_options.instrument; }
+    virtual unsigned int execute(function *);
+};
+
+unsigned int pass_runtime_checks::execute(function *fun) {
+    if (!g_check_sites_planned) plan_check_sites();
+
+    // Collected first: sampled checks split blocks.
+    std::vector<std::pair<gimple *, unsigned> > casts;
+    basic_block bb;
+    FOR_EACH_BB_FN(bb, fun) {
+        for (gimple_stmt_iterator gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+            auto it = g_check_periods.find(gsi_stmt(gsi));
+            if (it != g_check_periods.end() && it->second && is_planned_cast(it->first)) {
+                casts.push_back(*it);
+            }
+        }
+    }
+    if (casts.empty()) return 0;
+
+    for (const std::pair<gimple *, unsigned> &cast : casts) {
+        insert_check(cast.first, cast.second);
+    }
+    free_dominance_info(fun, CDI_DOMINATORS);
+    mark_virtual_operands_for_renaming(fun);
+    return TODO_update_ssa;
+}
+
+// Prints the check sites of the unit and the dynamic checks the profile predicts.
+static void report_check_sites() {
+    unsigned sites = g_check_sites_full + g_check_sites_sampled + g_check_sites_unchecked;
+    fprintf(stderr,
+            "narrowing_cast_plugin: %s: %u check sites: %u full, %u sampled, %u unchecked\n",
+            main_input_filename, sites, g_check_sites_full, g_check_sites_sampled,
+            g_check_sites_unchecked);
+    if (g_check_profile) {
+        fprintf(stderr,
+                "narrowing_cast_plugin: %s: expected %.0f dynamic checks per profiled run\n",
+                main_input_filename, g_expected_checks);
+    }
+    g_check_periods.clear();
+    g_check_lines.clear();
+}
+
+// ===================== Format-string checking =====================
+
+// Length modifiers of a conversion specification.
+enum format_length {
+    FMT_LEN_NONE,
+    FMT_LEN_HH,
+    FMT_LEN_H,
+    FMT_LEN_L,
+    FMT_LEN_LL,
+    FMT_LEN_J,
+    FMT_LEN_Z,
+    FMT_LEN_T,
+    FMT_LEN_BIG_L,
+};
+
+// One argument-consuming part of a format string: a conversion, or a '*'
+// width or precision.
+struct format_arg_spec {
+    format_length length;
+    char conversion;
+};
+
+// Parsed format strings keyed by STRING_CST, so each literal is parsed once,
+// indexed by whether it was parsed as a scanf format.
+static std::unordered_map<tree, std::vector<format_arg_spec>> g_format_cache[2];
+
+// Parses a printf- or scanf-style format string into the specs consuming
+// variadic arguments, in order. Formats using positional "%n$" arguments are
+// left empty, as arguments can then no longer be matched by counting.
+static void parse_format_string(const char *str, size_t len, bool is_scanf,
+                                std::vector<format_arg_spec> *specs) {
+    for (size_t i = 0; i < len; ++i) {
+        if (str[i] != '%') continue;
+        if (++i >= len) break;
+        if (str[i] == '%') continue;
+
+        size_t digits = strspn(str + i, "0123456789");
+        if (digits && str[i + digits] == '$') {
+            specs->clear();
+            return;
+        }
+
+        bool suppressed = false;
+        if (is_scanf && str[i] == '*') {
+            suppressed = true;
+            ++i;
+        }
+        while (i < len && strchr("-+ #0'", str[i])) ++i;
+        if (!is_scanf && i < len && str[i] == '*') {
+            specs->push_back({FMT_LEN_NONE, '*'});
+            ++i;
+        }
+        while (i < len && ISDIGIT(str[i])) ++i;
+        // The scanf allocation modifier, as in "%ms", follows the width.
+        if (is_scanf && i < len && str[i] == 'm') ++i;
+        if (!is_scanf && i < len && str[i] == '.') {
+            ++i;
+            if (i < len && str[i] == '*') {
+                specs->push_back({FMT_LEN_NONE, '*'});
+                ++i;
+            }
+            while (i < len && ISDIGIT(str[i])) ++i;
+        }
+
+        format_length length = FMT_LEN_NONE;
+        if (i + 1 < len && str[i] == 'h' && str[i + 1] == 'h') {
+            length = FMT_LEN_HH;
+            i += 2;
+        } else if (i + 1 < len && str[i] == 'l' && str[i + 1] == 'l') {
+            length = FMT_LEN_LL;
+            i += 2;
+        } else if (i < len) {
+            switch (str[i]) {
+                case 'h': length = FMT_LEN_H; ++i; break;
+                case 'l': length = FMT_LEN_L; ++i; break;
+                case 'q': length = FMT_LEN_LL; ++i; break;
+                case 'j': length = FMT_LEN_J; ++i; break;
+                case 'z': length = FMT_LEN_Z; ++i; break;
+                case 't': length = FMT_LEN_T; ++i; break;
+                case 'L': length = FMT_LEN_BIG_L; ++i; break;
+                default: break;
+            }
+        }
+        if (i >= len) break;
+
+        char conversion = str[i];
+        if (conversion == '[') {
+            // Skip the scanset; a leading ']' belongs to the set.
+            if (i + 1 < len && str[i + 1] == '^') ++i;
+            if (i + 1 < len && str[i + 1] == ']') ++i;
+            while (i + 1 < len && str[i + 1] != ']') ++i;
+            ++i;
+        }
+        // printf's %m prints strerror(errno) and takes no argument.
+        if (!suppressed && (is_scanf || conversion != 'm')) {
+            specs->push_back({length, conversion});
+        }
+    }
+}
+
+// Helper to get the parsed specs of a format argument, or NULL if the
+// argument is not a string literal.
+static const std::vector<format_arg_spec> *get_format_specs(tree format_arg, bool is_scanf) {
+    STRIP_NOPS(format_arg);
+    if (TREE_CODE(format_arg) != ADDR_EXPR) return NULL;
+    tree str = TREE_OPERAND(format_arg, 0);
+    if (TREE_CODE(str) == ARRAY_REF) str = TREE_OPERAND(str, 0);
+    if (TREE_CODE(str) != STRING_CST) return NULL;
+
+    auto inserted = g_format_cache[is_scanf].emplace(str, std::vector<format_arg_spec>());
+    if (inserted.second) {
+        parse_format_string(TREE_STRING_POINTER(str), TREE_STRING_LENGTH(str), is_scanf,
+                            &inserted.first->second);
+    }
+    return &inserted.first->second;
+}
+
+// Helper to get the type a conversion specification reads its argument as,
+// or NULL_TREE for conversions that do not take a number.
+static tree get_format_spec_type(const format_arg_spec &spec, bool is_scanf) {
+    if (strchr("diouxX", spec.conversion)) {
+        switch (spec.length) {
+            case FMT_LEN_HH: return char_type_node;
+            case FMT_LEN_H: return short_integer_type_node;
+            case FMT_LEN_L: return long_integer_type_node;
+            case FMT_LEN_LL: return long_long_integer_type_node;
+            // intmax_type_node lives in the C-family front ends' c_global_trees,
+            // which lto1 lacks; intmax_t is as wide as long long on all targets.
+            case FMT_LEN_J: return long_long_integer_type_node;
+            case FMT_LEN_Z: return size_type_node;
+            case FMT_LEN_T: return ptrdiff_type_node;
+            default: return integer_type_node;
+        }
+    }
+    if (strchr("aAeEfFgG", spec.conversion)) {
+        if (spec.length == FMT_LEN_BIG_L) return long_double_type_node;
+        if (is_scanf && spec.length == FMT_LEN_NONE) return float_type_node;
+        return double_type_node;
+    }
+    return NULL_TREE;
+}
+
+// Checks the variadic arguments of a call to a function with a printf- or
+// scanf-style format attribute against their conversion specifications.
+static void check_format_arguments(tree call, tree fntype, location_t loc, walk_data *data) {
+    for (tree attr = lookup_attribute("format", TYPE_ATTRIBUTES(fntype)); attr;
+         attr = lookup_attribute("format", TREE_CHAIN(attr))) {
+        tree args = TREE_VALUE(attr);
+        if (!args || !TREE_CHAIN(args) || !TREE_CHAIN(TREE_CHAIN(args))) continue;
 
-    // For binary expressions, the node's own type might not be promoted yet.
-    // Instead, deduce the result type by finding the widest operand type.
-    switch (TREE_CODE(current_expr)) {
-        case PLUS_EXPR:
-        case MINUS_EXPR:
-        case MULT_EXPR:
-        case TRUNC_DIV_EXPR:
-        case RDIV_EXPR: {
-            tree op0 = TREE_OPERAND(current_expr, 0);
-            tree op1 = TREE_OPERAND(current_expr, 1);
-            if (op0 && op1) {
-                tree type0 = get_original_type(op0);
-                tree type1 = get_original_type(op1);
-                if (is_numeric_type(type0) && is_numeric_type(type1)) {
-                    if (TYPE_PRECISION(type0) > TYPE_PRECISION(type1)) {
-                        DEBUG_PRINT("    deduced binary expr type from operand 0: %s\n",
-                                    get_type_name(type0));
-                        return type0;
-                    } else {
-                        DEBUG_PRINT("    deduced binary expr type from operand 1: %s\n",
-                                    get_type_name(type1));
-                        return type1;
-                    }
-                }
+        const char *archetype = IDENTIFIER_POINTER(TREE_VALUE(args));
+        bool is_scanf = strstr(archetype, "scanf") != NULL;
+        if (!is_scanf && !strstr(archetype, "printf")) continue;
+
+        int format_num = tree_to_shwi(TREE_VALUE(TREE_CHAIN(args)));
+        int first_arg = tree_to_shwi(TREE_VALUE(TREE_CHAIN(TREE_CHAIN(args))));
+        if (first_arg == 0 || format_num > call_expr_nargs(call)) continue;
+
+        const std::vector<format_arg_spec> *specs =
+            get_format_specs(CALL_EXPR_ARG(call, format_num - 1), is_scanf);
+        if (!specs) continue;
+
+        int arg_index = first_arg - 1;
+        for (const format_arg_spec &spec : *specs) {
+            if (arg_index >= call_expr_nargs(call)) break;
+            tree arg = CALL_EXPR_ARG(call, arg_index++);
+            tree spec_type = get_format_spec_type(spec, is_scanf);
+            if (!spec_type) continue;
+
+            if (!is_scanf) {
+                check_narrowing_conversion(loc, spec_type, arg, NULL_TREE, CONTEXT_FORMAT,
+                                           "format argument", data);
+                continue;
+            }
+
+            // scanf stores only as many bytes as the specification names.
+            tree ptr_type = get_original_type(arg);
+            if (ptr_type && TREE_CODE(ptr_type) == POINTER_TYPE) {
+                tree stored = build1(INDIRECT_REF, TREE_TYPE(ptr_type), arg);
+                check_narrowing_conversion(loc, spec_type, stored, NULL_TREE, CONTEXT_FORMAT,
+                                           "scanf format argument", data);
             }
-            break;  // Fallthrough to default behavior if operands are weird
         }
-        default:
-            break;  // Do nothing, use default logic below
     }
-
-    tree result_type = TREE_TYPE(current_expr);
-    DEBUG_PRINT("    original type is: %s\n", get_type_name(result_type));
-    return result_type;
 }
 
-// The core logic to detect narrowing conversion.
-static void check_narrowing_conversion(location_t loc, tree to_type, tree from_expr,
-                                       const char *context) {
-    tree from_type = get_original_type(from_expr);
+// Analysis time of the unit so far, in get_run_time() units (microseconds).
+static long g_analysis_time;
+// Functions skipped entirely because the unit's time budget ran out.
+static unsigned g_budget_skipped_functions;
 
-    if (!to_type || !from_type || to_type == error_mark_node || from_type == error_mark_node) {
-        return;
-    }
+// Helper to check the unit's analysis time against its budget.
+static bool unit_time_budget_exceeded(long analysis_time) {
+    return g_options.time_budget_ms && analysis_time / 1000 > (long)g_options.time_budget_ms;
+}
 
-    DEBUG_PRINT("Checking conversion in %s...\n", context);
-    DEBUG_PRINT("  To  : %s (precision: %u)\n", get_type_name(to_type), TYPE_PRECISION(to_type));
-    DEBUG_PRINT("  From: %s (precision: %u)\n", get_type_name(from_type),
-                TYPE_PRECISION(from_type));
+// Counts a visited node against the function's node budget and, every 1024
+// nodes, checks the unit's time budget.
+static bool analysis_budget_exceeded(walk_data *data) {
+    data->nodes_visited++;
+    if (g_options.node_budget && data->nodes_visited > g_options.node_budget) return true;
+    return (data->nodes_visited & 1023) == 0 &&
+           unit_time_budget_exceeded(g_analysis_time + get_run_time() - data->start_time);
+}
 
-    if (is_numeric_type(to_type) && is_numeric_type(from_type)) {
-        tree from_type_main = TYPE_MAIN_VARIANT(from_type);
-        tree to_type_main = TYPE_MAIN_VARIANT(to_type);
+// Helper for the walks that precede the traversal, which share its budget:
+// charges a node and marks the function truncated once the budget is spent.
+static bool walk_budget_exceeded(walk_data *data) {
+    if (!data->truncated && analysis_budget_exceeded(data)) data->truncated = true;
+    return data->truncated;
+}
 
-        tree_code from_code = TREE_CODE(from_type_main);
-        tree_code to_code = TREE_CODE(to_type_main);
+// ===================== Function prefilter =====================
 
-        unsigned int from_precision = TYPE_PRECISION(from_type);
-        unsigned int to_precision = TYPE_PRECISION(to_type);
+// Extremes of the numeric types seen in a function. A lossy conversion needs a
+// source type that is wider than its destination, and both types appear in
+// the function, so testing the extremes against each other is enough.
+struct numeric_type_range {
+    bool has_int;
+    bool has_real;
+    bool unbounded;  // A check whose destination type is not in the body.
+    walk_data *budget;
+    type_desc widest_int;
+    type_desc narrowest_int;
+    type_desc widest_real;
+    type_desc narrowest_real;
+};
 
-        // Case 1: Standard narrowing conversion (e.g., int64 -> int32, double -> float)
-        bool standard_narrowing = (from_precision > to_precision && from_code == to_code);
+// Functions checked by the prefilter and those it found no conversion in, and
+// the time the prefilter took, which is part of the analysis time.
+static unsigned g_prefilter_functions;
+static unsigned g_prefilter_skipped;
+static long g_prefilter_time;
 
-        // Case 2: int64 -> float (loss of precision)
-        bool int64_to_float =
-            (from_code == INTEGER_TYPE &&
-             from_precision >
-                 53 &&  // float has 24 bits, double 53. Long long definitely loses precision.
-             to_code == REAL_TYPE);
+// Nodes the prefilter walk has visited in the current function. Kept across
+// functions so that each walk reuses the table instead of allocating one.
+static hash_set<tree> *g_prefilter_visited;
 
-        // Case 3: double -> int (loss of precision and range)
-        bool float_to_int_narrowing =
-            (from_code == REAL_TYPE && to_code == INTEGER_TYPE && from_precision > to_precision);
+// Helper to widen a range by a type; true if an extreme changed.
+static bool note_numeric_type(numeric_type_range *range, tree type) {
+    if (!type || type == error_mark_node) return false;
+    type_desc desc = get_type_desc(type);
+    if (desc.kind == TYPE_KIND_OTHER) return false;
+    if (desc.kind == TYPE_KIND_POINTER) {
+        // Pointers only matter as sources of ptr-trunc, where they act as integers.
+        if (!g_pointer_rule_enabled) return false;
+        desc.kind = TYPE_KIND_INTEGER;
+    }
 
-        if (standard_narrowing || int64_to_float || float_to_int_narrowing) {
-            DEBUG_PRINT("  >>> POTENTIALLY DANGEROUS CAST DETECTED <<<\n");
-            warning_at(loc, 0, "Y2038 potential issue: lossy conversion from %s to %s in %s",
-                       get_type_name(from_type), get_type_name(to_type), context);
-        }
+    bool real = desc.kind == TYPE_KIND_REAL;
+    bool &has = real ? range->has_real : range->has_int;
+    type_desc &widest = real ? range->widest_real : range->widest_int;
+    type_desc &narrowest = real ? range->narrowest_real : range->narrowest_int;
+    if (!has) {
+        has = true;
+        widest = narrowest = desc;
+        return true;
+    }
+    if (desc.precision > widest.precision) {
+        widest = desc;
+        return true;
+    }
+    if (desc.precision < narrowest.precision) {
+        narrowest = desc;
+        return true;
     }
+    return false;
 }
 
-// Helper function to reliably get the FUNCTION_DECL from a callee expression.
-static tree get_fndecl_from_callee_expr(tree callee) {
-    if (!callee) return NULL_TREE;
+// Whether the types of a range allow any lossy conversion.
+static bool range_may_narrow(const numeric_type_range *range) {
+    if (range->unbounded) return true;
+    if (range->has_int && is_lossy_conversion(range->widest_int, range->narrowest_int)) {
+        return true;
+    }
+    if (range->has_real && is_lossy_conversion(range->widest_real, range->narrowest_real)) {
+        return true;
+    }
+    return range->has_int && range->has_real &&
+           (is_lossy_conversion(range->widest_int, range->narrowest_real) ||
+            is_lossy_conversion(range->widest_real, range->narrowest_int));
+}
 
-    DEBUG_PRINT("  get_fndecl_from_callee_expr on: %s\n", get_tree_code_name(TREE_CODE(callee)));
-    // Peel back layers until we find the FUNCTION_DECL or can't go further.
-    while (callee) {
-        if (TREE_CODE(callee) == FUNCTION_DECL) {
-            return callee;
+// walk_tree callback adding the types of a node to the range; stops the walk
+// as soon as a lossy conversion becomes possible.
+static tree prefilter_node(tree *tp, int *walk_subtrees, void *data) {
+    numeric_type_range *range = (numeric_type_range *)data;
+    tree node = *tp;
+    if (walk_budget_exceeded(range->budget)) return node;
+    if (TYPE_P(node)) {
+        *walk_subtrees = 0;
+        return NULL_TREE;
+    }
+
+    bool changed = note_numeric_type(range, TREE_TYPE(node));
+    if (TREE_CODE(node) == BIND_EXPR) {
+        for (tree var = BIND_EXPR_VARS(node); var; var = DECL_CHAIN(var)) {
+            changed |= note_numeric_type(range, TREE_TYPE(var));
         }
-        if (TREE_CODE(callee) == ADDR_EXPR || TREE_CODE(callee) == NOP_EXPR ||
-            TREE_CODE(callee) == CONVERT_EXPR) {
-            callee = TREE_OPERAND(callee, 0);
-        } else {
-            // Can't unwrap further.
-            return NULL_TREE;
+    } else if (TREE_CODE(node) == CONSTRUCTOR) {
+        // Aggregate initializers convert to the types of the fields.
+        unsigned HOST_WIDE_INT i;
+        tree field, value;
+        FOR_EACH_CONSTRUCTOR_ELT(CONSTRUCTOR_ELTS(node), i, field, value) {
+            if (field && TREE_CODE(field) == FIELD_DECL) {
+                changed |= note_numeric_type(range, TREE_TYPE(field));
+            }
+        }
+    } else if (TREE_CODE(node) == CALL_EXPR) {
+        tree fndecl = get_fndecl_from_callee_expr(CALL_EXPR_FN(node));
+        tree fntype = fndecl ? TREE_TYPE(fndecl) : NULL_TREE;
+        if (fntype) {
+            for (tree arg = TYPE_ARG_TYPES(fntype); arg; arg = TREE_CHAIN(arg)) {
+                changed |= note_numeric_type(range, TREE_VALUE(arg));
+            }
+            // Format arguments are checked against types named by the format string.
+            if (lookup_attribute("format", TYPE_ATTRIBUTES(fntype))) range->unbounded = true;
+            changed |= range->unbounded;
+        }
+    }
+    return changed && range_may_narrow(range) ? node : NULL_TREE;
+}
+
+// Cheap check that a function may contain a lossy conversion. The signature
+// and the outermost locals usually decide; otherwise the types of the body's
+// nodes are collected without any of the checks. The walk is charged to the
+// function's budget, and a function that exhausts it is not skipped.
+static bool function_may_narrow(tree fndecl, tree body, walk_data *data) {
+    numeric_type_range range;
+    memset(&range, 0, sizeof(range));
+    range.budget = data;
+    note_numeric_type(&range, TREE_TYPE(DECL_RESULT(fndecl)));
+    for (tree parm = DECL_ARGUMENTS(fndecl); parm; parm = DECL_CHAIN(parm)) {
+        note_numeric_type(&range, TREE_TYPE(parm));
+    }
+    tree block = DECL_INITIAL(fndecl);
+    if (block && TREE_CODE(block) == BLOCK) {
+        for (tree var = BLOCK_VARS(block); var; var = DECL_CHAIN(var)) {
+            note_numeric_type(&range, TREE_TYPE(var));
         }
     }
+    if (range_may_narrow(&range)) return true;
+
+    if (!g_prefilter_visited) g_prefilter_visited = new hash_set<tree>;
+    bool may_narrow = walk_tree(&body, prefilter_node, &range, g_prefilter_visited) != NULL_TREE;
+    g_prefilter_visited->empty();
+    return may_narrow;
+}
+
+// ===================== Dead code pruning =====================
+
+// Branches ruled out by a constant condition, including if (0) and the
+// discarded branch of if constexpr, are skipped by the traversal. Operands of
+// sizeof, alignof and noexcept need no handling: the front end has already
+// folded them to constants.
+static unsigned g_pruned_subtrees;
+
+// Callback for walk_tree to find a label; the walk stops at the first one.
+static tree find_label(tree *tp, int *walk_subtrees, void *data) {
+    (void)data;
+    if (TREE_CODE(*tp) == LABEL_EXPR || TREE_CODE(*tp) == CASE_LABEL_EXPR) return *tp;
+    if (TYPE_P(*tp)) *walk_subtrees = 0;
     return NULL_TREE;
 }
 
+// Counts a subtree as pruned; false if a label in it may be jumped to, in
+// which case it must be traversed after all.
+static bool prune_subtree(tree node) {
+    if (!node) return true;
+    if (walk_tree_without_duplicates(&node, find_label, NULL)) return false;
+    g_pruned_subtrees++;
+    return true;
+}
+
+// Helper to get the value of a condition known at compile time: 0 or 1, or
+// -1 if it is not a constant.
+static int get_constant_condition(tree cond) {
+    while (cond && (CONVERT_EXPR_P(cond) || TREE_CODE(cond) == NON_LVALUE_EXPR ||
+                    TREE_CODE(cond) == CLEANUP_POINT_EXPR)) {
+        cond = TREE_OPERAND(cond, 0);
+    }
+    if (!cond || TREE_CODE(cond) != INTEGER_CST) return -1;
+    return integer_zerop(cond) ? 0 : 1;
+}
+
+// Element stores split off namespace-scope aggregate initializers. They are
+// counted with their variable by finish_decl_callback(), and not reported
+// again in the static initialization function, where the front end emits them.
+static std::unordered_set<tree> g_initializer_stores;
+
 // Our manual recursive AST traversal and checking function.
 static void traverse_and_check_ast(tree node, walk_data *data) {
-    if (node == NULL_TREE) {
+    if (node == NULL_TREE || data->truncated) {
+        return;
+    }
+    if (analysis_budget_exceeded(data)) {
+        data->truncated = true;
         return;
     }
 
@@ -216,27 +3495,31 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
             tree initializer = DECL_INITIAL(node);
             if (initializer) {
                 tree to_type = TREE_TYPE(node);
-                check_narrowing_conversion(DECL_SOURCE_LOCATION(node), to_type, initializer,
-                                           "variable initialization");
+                check_narrowing_conversion(DECL_SOURCE_LOCATION(node), to_type, initializer, node,
+                                           CONTEXT_INITIALIZATION, "variable initialization",
+                                           data);
             }
             break;
         }
         case MODIFY_EXPR: {  // Handle assignments
             tree lhs = TREE_OPERAND(node, 0);
             tree rhs = TREE_OPERAND(node, 1);
-            check_narrowing_conversion(loc, TREE_TYPE(lhs), rhs, "assignment");
+            check_narrowing_conversion(loc, TREE_TYPE(lhs), rhs, lhs, CONTEXT_ASSIGNMENT,
+                                       "assignment", data);
             break;
         }
         case INIT_EXPR: {
             tree dest = TREE_OPERAND(node, 0);
             tree source = TREE_OPERAND(node, 1);
-            if (dest && source && TREE_TYPE(dest)) {
+            if (dest && source && TREE_TYPE(dest) &&
+                (g_initializer_stores.empty() || !g_initializer_stores.count(node))) {
                 location_t reliable_loc = loc;
                 if (TREE_CODE(dest) == VAR_DECL) {
                     reliable_loc = DECL_SOURCE_LOCATION(dest);
                 }
-                check_narrowing_conversion(reliable_loc, TREE_TYPE(dest), source,
-                                           "initializer expression");
+                check_narrowing_conversion(reliable_loc, TREE_TYPE(dest), source, dest,
+                                           CONTEXT_INITIALIZATION, "initializer expression",
+                                           data);
             }
             break;
         }
@@ -253,7 +3536,8 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
                 tree to_type = TREE_TYPE(node);
                 tree from_expr = TREE_OPERAND(node, 0);
                 if (from_expr) {
-                    check_narrowing_conversion(loc, to_type, from_expr, "implicit conversion");
+                    check_narrowing_conversion(loc, to_type, from_expr, NULL_TREE,
+                                               CONTEXT_IMPLICIT, "implicit conversion", data);
                 }
             }
             break;
@@ -270,6 +3554,11 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
             tree fntype = TREE_TYPE(fn_decl);
             DEBUG_PRINT("  Function type is: %s\n", get_type_name(fntype));
 
+            const known_api *api = lookup_known_api(fn_decl);
+            const char *arg_context = api && (api->flags & KNOWN_API_SERIALIZES)
+                                          ? "serialization argument"
+                                          : "function argument";
+
             tree arg_types = TYPE_ARG_TYPES(fntype);
 
             tree arg;
@@ -283,18 +3572,38 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
                 }
                 tree param_type = TREE_VALUE(arg_types);
                 if (param_type && arg) {
-                    check_narrowing_conversion(loc, param_type, arg, "function argument");
+                    check_narrowing_conversion(loc, param_type, arg, NULL_TREE, CONTEXT_ARGUMENT,
+                                               arg_context, data);
                 } else {
                     DEBUG_PRINT("    param_type or arg is NULL.\n");
                 }
                 arg_types = TREE_CHAIN(arg_types);
             }
+
+            // Variadic arguments have no parameter type; match them against
+            // the format string instead.
+            check_format_arguments(node, fntype, loc, data);
             break;
         }
         case RETURN_EXPR: {  // Handle return statements
             if (TREE_OPERAND(node, 0)) {
                 tree retval = TREE_OPERAND(node, 0);
-                check_narrowing_conversion(loc, data->function_return_type, retval, "return value");
+                check_narrowing_conversion(loc, data->function_return_type, retval, NULL_TREE,
+                                           CONTEXT_RETURN, "return value", data);
+            }
+            break;
+        }
+        case CONSTRUCTOR: {  // Handle aggregate initializers of records
+            if (!g_options.field_report || TREE_CODE(TREE_TYPE(node)) != RECORD_TYPE) break;
+
+            unsigned HOST_WIDE_INT idx;
+            tree field, value;
+            FOR_EACH_CONSTRUCTOR_ELT(CONSTRUCTOR_ELTS(node), idx, field, value) {
+                if (field && TREE_CODE(field) == FIELD_DECL && value) {
+                    check_narrowing_conversion(loc, TREE_TYPE(field), value, field,
+                                               CONTEXT_INITIALIZATION, "aggregate initializer",
+                                               data);
+                }
             }
             break;
         }
@@ -324,8 +3633,6 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
         case BIT_XOR_EXPR:
         case BIT_AND_EXPR:
         case BIT_NOT_EXPR:
-        case TRUTH_ANDIF_EXPR:
-        case TRUTH_ORIF_EXPR:
         case TRUTH_AND_EXPR:
         case TRUTH_OR_EXPR:
         case TRUTH_XOR_EXPR:
@@ -349,7 +3656,6 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
         case MODIFY_EXPR:
         case INIT_EXPR:
         case TARGET_EXPR:
-        case COND_EXPR:
         case VEC_COND_EXPR:
         case VEC_PERM_EXPR:
         case CALL_EXPR:
@@ -377,6 +3683,30 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
             }
             break;
 
+        // Branches that a constant condition rules out.
+        case COND_EXPR: {
+            int value = get_constant_condition(TREE_OPERAND(node, 0));
+            traverse_and_check_ast(TREE_OPERAND(node, 0), data);
+            if (value != 0 || !prune_subtree(TREE_OPERAND(node, 1))) {
+                traverse_and_check_ast(TREE_OPERAND(node, 1), data);
+            }
+            if (value != 1 || !prune_subtree(TREE_OPERAND(node, 2))) {
+                traverse_and_check_ast(TREE_OPERAND(node, 2), data);
+            }
+            break;
+        }
+        case TRUTH_ANDIF_EXPR:
+        case TRUTH_ORIF_EXPR: {
+            // 0 && x and 1 || x never evaluate x.
+            int skip_value = code == TRUTH_ANDIF_EXPR ? 0 : 1;
+            traverse_and_check_ast(TREE_OPERAND(node, 0), data);
+            if (get_constant_condition(TREE_OPERAND(node, 0)) != skip_value ||
+                !prune_subtree(TREE_OPERAND(node, 1))) {
+                traverse_and_check_ast(TREE_OPERAND(node, 1), data);
+            }
+            break;
+        }
+
         // Statements that contain other statements or expressions.
         case BIND_EXPR:
             if (BIND_EXPR_VARS(node)) traverse_and_check_ast(BIND_EXPR_VARS(node), data);
@@ -390,20 +3720,34 @@ static void traverse_and_check_ast(tree node, walk_data *data) {
         case EXPR_STMT:
             traverse_and_check_ast(EXPR_STMT_EXPR(node), data);
             break;
-        case IF_STMT:
+        case IF_STMT: {
+            // Also covers the discarded branch of a non-dependent if constexpr.
+            int value = get_constant_condition(IF_COND(node));
             traverse_and_check_ast(IF_COND(node), data);
-            traverse_and_check_ast(THEN_CLAUSE(node), data);
-            if (ELSE_CLAUSE(node)) traverse_and_check_ast(ELSE_CLAUSE(node), data);
+            if (value != 0 || !prune_subtree(THEN_CLAUSE(node))) {
+                traverse_and_check_ast(THEN_CLAUSE(node), data);
+            }
+            if (ELSE_CLAUSE(node) && (value != 1 || !prune_subtree(ELSE_CLAUSE(node)))) {
+                traverse_and_check_ast(ELSE_CLAUSE(node), data);
+            }
             break;
+        }
         case FOR_STMT:
             traverse_and_check_ast(FOR_INIT_STMT(node), data);
             traverse_and_check_ast(FOR_COND(node), data);
-            traverse_and_check_ast(FOR_EXPR(node), data);
-            traverse_and_check_ast(FOR_BODY(node), data);
+            // An absent condition loops forever; a false one never enters.
+            if (!FOR_COND(node) || get_constant_condition(FOR_COND(node)) != 0 ||
+                !prune_subtree(FOR_BODY(node)) || !prune_subtree(FOR_EXPR(node))) {
+                traverse_and_check_ast(FOR_EXPR(node), data);
+                traverse_and_check_ast(FOR_BODY(node), data);
+            }
             break;
         case WHILE_STMT:
             traverse_and_check_ast(WHILE_COND(node), data);
-            traverse_and_check_ast(WHILE_BODY(node), data);
+            if (get_constant_condition(WHILE_COND(node)) != 0 ||
+                !prune_subtree(WHILE_BODY(node))) {
+                traverse_and_check_ast(WHILE_BODY(node), data);
+            }
             break;
         case DO_STMT:
             traverse_and_check_ast(DO_BODY(node), data);
@@ -454,10 +3798,547 @@ static void pre_genericize_callback(void *gcc_data, void *user_data) {
     DEBUG_PRINT("\n--- Processing function: %s ---\n",
                 IDENTIFIER_POINTER(DECL_ASSEMBLER_NAME(fndecl)));
 
+    if (unit_time_budget_exceeded(g_analysis_time)) {
+        g_budget_skipped_functions++;
+        return;
+    }
+    // Every walk over the body below, fingerprinting included, is charged to
+    // the function's node budget and to the unit's analysis time.
     walk_data data;
     data.function_return_type = TREE_TYPE(DECL_RESULT(fndecl));
+    data.taint = NULL;
+    data.nodes_visited = 0;
+    data.start_time = get_run_time();
+    data.truncated = false;
+
+    if (g_options.fingerprint_db && check_function_fingerprint(fndecl, body, &data)) {
+        g_analysis_time += get_run_time() - data.start_time;
+        return;
+    }
+
+    taint_state taint;
+    taint.tainted = NULL;
+    if (g_options.taint) {
+        compute_time_taint(fndecl, body, &data, &taint);
+    }
+
+    bool may_narrow = true;
+    if (g_options.prefilter && !data.truncated) {
+        long prefilter_start = get_run_time();
+        g_prefilter_functions++;
+        may_narrow = function_may_narrow(fndecl, body, &data);
+        if (!may_narrow) g_prefilter_skipped++;
+        g_prefilter_time += get_run_time() - prefilter_start;
+    }
+    if (may_narrow) {
+        traverse_and_check_ast(body, &data);
+    }
+
+    if (data.truncated) {
+        record_budget_finding(FINDING_TRUNCATED, DECL_SOURCE_LOCATION(fndecl),
+                              lang_hooks.decl_printable_name(fndecl, 2), data.nodes_visited);
+        if (g_current_function != NO_FUNCTION) {
+            g_function_fingerprints[g_current_function].complete = false;
+        }
+    }
+    g_current_function = NO_FUNCTION;
 
-    traverse_and_check_ast(body, &data);
+    // A truncated function gets no summary; its callers see an unknown callee.
+    if (g_options.taint && !data.truncated) {
+        record_taint_summary(fndecl, body, &data);
+    }
+
+    if (taint.tainted) {
+        sbitmap_free(taint.tainted);
+    }
+    g_analysis_time += get_run_time() - data.start_time;
+}
+
+// ===================== Global initializers =====================
+
+// Namespace-scope and static variables are never part of a function body, so
+// their initializers are checked when the front end finishes the declaration.
+// A lossy aggregate initializer is reported once, with the number of lossy
+// elements, however large the table.
+
+// Lossy elements found in one aggregate initializer.
+struct initializer_scan {
+    tree decl;
+    const walk_data *data;
+    unsigned elements;
+    unsigned lossy;
+    tree from_type;  // Types and rule of the first lossy element.
+    tree to_type;
+    int rule;
+};
+
+// Elements checked in this unit, for the statistics.
+static unsigned long g_initializer_elements;
+
+static void scan_initializer(tree init, tree type, initializer_scan *scan);
+
+// Helper to count one lossy element, or a field store with field-report.
+static void note_lossy_element(initializer_scan *scan, tree field, tree from_type, tree to_type,
+                               int rule) {
+    if (g_options.field_report && field && TREE_CODE(field) == FIELD_DECL) {
+        record_field_store(field, DECL_SOURCE_LOCATION(scan->decl), from_type, to_type, rule);
+        return;
+    }
+    if (scan->lossy++ == 0) {
+        scan->from_type = from_type;
+        scan->to_type = to_type;
+        scan->rule = rule;
+    }
+}
+
+// Checks one element of an aggregate initializer against its declared type.
+static void scan_initializer_element(tree value, tree field, tree to_type,
+                                     initializer_scan *scan) {
+    if (!value || !to_type || value == error_mark_node) return;
+    if (TREE_CODE(value) == CONSTRUCTOR) {
+        scan_initializer(value, to_type, scan);
+        return;
+    }
+
+    scan->elements++;
+    tree from_type = get_original_type(value);
+    if (!from_type || from_type == error_mark_node || from_type == to_type) return;
+    // A constant that still carries a wider type is lossy only if it does not fit.
+    if (TREE_CODE(value) == INTEGER_CST && INTEGRAL_TYPE_P(to_type) &&
+        int_fits_type_p(value, to_type)) {
+        return;
+    }
+
+    int rule = match_rule(CONTEXT_INITIALIZATION, get_type_desc(from_type), get_type_desc(to_type));
+    if (rule < 0) return;
+    if (g_options.taint && conversion_rules[rule].time_taint &&
+        !expr_is_time_tainted(value, scan->data)) {
+        return;
+    }
+    note_lossy_element(scan, field, from_type, to_type, rule);
+}
+
+// Checks the elements of an aggregate initializer of the given type.
+static void scan_initializer(tree init, tree type, initializer_scan *scan) {
+    vec<constructor_elt, va_gc> *elts = CONSTRUCTOR_ELTS(init);
+    unsigned length = vec_safe_length(elts);
+
+    if (TREE_CODE(type) == ARRAY_TYPE) {
+        tree elem_type = TREE_TYPE(type);
+        unsigned i = 0;
+        // Fast path for tables of integer constants already of the element
+        // type: they were range-checked by the front end, so only elements of
+        // another type or form need a closer look.
+        if (INTEGRAL_TYPE_P(elem_type)) {
+            for (; i < length; ++i) {
+                tree value = (*elts)[i].value;
+                if (TREE_CODE(value) != INTEGER_CST || TREE_TYPE(value) != elem_type) break;
+            }
+            scan->elements += i;
+        }
+        for (; i < length; ++i) {
+            scan_initializer_element((*elts)[i].value, NULL_TREE, elem_type, scan);
+        }
+        return;
+    }
+
+    // Records and unions: each element names the field it initializes.
+    for (unsigned i = 0; i < length; ++i) {
+        tree field = (*elts)[i].index;
+        if (field && TREE_CODE(field) == FIELD_DECL) {
+            scan_initializer_element((*elts)[i].value, field, TREE_TYPE(field), scan);
+        }
+    }
+}
+
+// Callback for walk_tree over the dynamic part of an aggregate initializer:
+// checks each element store, as the front end no longer has them in
+// DECL_INITIAL.
+static tree scan_initializer_store(tree *tp, int *walk_subtrees, void *data) {
+    initializer_scan *scan = (initializer_scan *)data;
+    tree node = *tp;
+    if (TREE_CODE(node) != INIT_EXPR && TREE_CODE(node) != MODIFY_EXPR) return NULL_TREE;
+    *walk_subtrees = 0;
+
+    tree dest = TREE_OPERAND(node, 0);
+    if (TREE_CODE(dest) != ARRAY_REF && TREE_CODE(dest) != COMPONENT_REF) return NULL_TREE;
+    tree field = TREE_CODE(dest) == COMPONENT_REF ? TREE_OPERAND(dest, 1) : NULL_TREE;
+    scan_initializer_element(TREE_OPERAND(node, 1), field, TREE_TYPE(dest), scan);
+    g_initializer_stores.insert(node);
+    return NULL_TREE;
+}
+
+// static_aggregates belongs to the C++ front end; a weak reference keeps the
+// plugin loadable in lto1.
+#pragma weak static_aggregates
+
+// Helper to get the dynamic part of a namespace-scope aggregate initializer.
+// Elements that are not constant are split off DECL_INITIAL into element
+// stores, which cp_finish_decl() queues in static_aggregates just before
+// PLUGIN_FINISH_DECL.
+static tree get_dynamic_initializer(tree decl) {
+    if (!&static_aggregates) return NULL_TREE;
+    if (decl_function_context(decl) || !CP_AGGREGATE_TYPE_P(TREE_TYPE(decl))) return NULL_TREE;
+    if (!static_aggregates || TREE_VALUE(static_aggregates) != decl) return NULL_TREE;
+    return TREE_PURPOSE(static_aggregates);
+}
+
+// Callback for the PLUGIN_FINISH_DECL event.
+static void finish_decl_callback(void *gcc_data, void *user_data) {
+    (void)user_data;
+    tree decl = (tree)gcc_data;
+    if (!decl || TREE_CODE(decl) != VAR_DECL || !TREE_STATIC(decl) || !TREE_TYPE(decl)) return;
+    tree init = DECL_INITIAL(decl);
+    if (init == error_mark_node) return;
+    tree dynamic = get_dynamic_initializer(decl);
+    if (!init && !dynamic) return;
+
+    bool aggregate = dynamic || TREE_CODE(init) == CONSTRUCTOR;
+    // Scalar statics inside functions are checked with the function body.
+    if (!aggregate && decl_function_context(decl)) return;
+
+    walk_data data;
+    data.function_return_type = NULL_TREE;
+    data.taint = NULL;
+    data.nodes_visited = 0;
+    data.start_time = get_run_time();
+    data.truncated = false;
+
+    if (!aggregate) {
+        // The same check as for a local variable, so that a global reached
+        // again from a function body is reported only once.
+        traverse_and_check_ast(decl, &data);
+    } else {
+        initializer_scan scan;
+        memset(&scan, 0, sizeof(scan));
+        scan.decl = decl;
+        scan.data = &data;
+        if (init && TREE_CODE(init) == CONSTRUCTOR) scan_initializer(init, TREE_TYPE(decl), &scan);
+        if (dynamic) walk_tree_without_duplicates(&dynamic, scan_initializer_store, &scan);
+        g_initializer_elements += scan.elements;
+
+        if (scan.lossy) {
+            char context[256];
+            snprintf(context, sizeof(context), "initializer of '%s' (%u of %u elements)",
+                     lang_hooks.decl_printable_name(decl, 2), scan.lossy, scan.elements);
+            conversion_candidate candidate = make_conversion_candidate(
+                DECL_SOURCE_LOCATION(decl), scan.from_type, scan.to_type, context);
+            candidate.rule = scan.rule;
+            candidate.count = scan.lossy;
+            store_candidate(candidate);
+        }
+    }
+
+    g_analysis_time += get_run_time() - data.start_time;
+}
+
+// ================== Record layout fingerprints ===================
+
+// Layout lines of the record types defined in this unit, by type name. Each
+// line is "<name>\t<hash>\t<size>\t<align>\t<fields>\t<unit>\t<file>:<line>",
+// where fields are "<name>:<bit offset>:<bit size>[:t]" separated by commas
+// and ":t" marks members holding a time value. layout_compare groups the
+// lines of all units by name and hash.
+static std::unordered_map<std::string, std::string> g_layouts;
+
+// Whether a type holds a time value, directly, in an array or in a member.
+static bool type_holds_time(tree type, int depth = 0) {
+    while (type && TREE_CODE(type) == ARRAY_TYPE) type = TREE_TYPE(type);
+    if (!type || depth > 8) return false;
+    if (get_type_desc(type).is_time) return true;
+    if (!RECORD_OR_UNION_TYPE_P(type) || !COMPLETE_TYPE_P(type)) return false;
+
+    for (tree field = TYPE_FIELDS(type); field; field = DECL_CHAIN(field)) {
+        if (TREE_CODE(field) == FIELD_DECL && type_holds_time(TREE_TYPE(field), depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Callback for the PLUGIN_FINISH_TYPE event: fingerprints a completed record.
+static void finish_type_callback(void *gcc_data, void *user_data) {
+    (void)user_data;
+    tree type = (tree)gcc_data;
+    if (!type || !RECORD_OR_UNION_TYPE_P(type) || !COMPLETE_TYPE_P(type) || !TYPE_NAME(type) ||
+        TREE_CODE(TYPE_NAME(type)) != TYPE_DECL || !tree_fits_uhwi_p(TYPE_SIZE_UNIT(type))) {
+        return;
+    }
+
+    uint64_t size = tree_to_uhwi(TYPE_SIZE_UNIT(type));
+    unsigned align = TYPE_ALIGN_UNIT(type);
+    uint64_t hash = hash_bytes(14695981039346656037ull, &size, sizeof(size));
+    hash = hash_bytes(hash, &align, sizeof(align));
+
+    std::string fields;
+    for (tree field = TYPE_FIELDS(type); field; field = DECL_CHAIN(field)) {
+        if (TREE_CODE(field) != FIELD_DECL) continue;
+        if (!tree_fits_shwi_p(bit_position(field)) || !DECL_SIZE(field) ||
+            !tree_fits_uhwi_p(DECL_SIZE(field))) {
+            return;  // Variable layout; nothing to compare.
+        }
+
+        const char *name = DECL_NAME(field) ? IDENTIFIER_POINTER(DECL_NAME(field))
+                                            : get_type_name(TREE_TYPE(field));
+        char position[64];
+        snprintf(position, sizeof(position), ":%lld:%llu%s", (long long)int_bit_position(field),
+                 (unsigned long long)tree_to_uhwi(DECL_SIZE(field)),
+                 type_holds_time(TREE_TYPE(field)) ? ":t" : "");
+        if (!fields.empty()) fields += ',';
+        fields += name;
+        fields += position;
+    }
+    hash = hash_bytes(hash, fields.data(), fields.size());
+
+    const char *name = lang_hooks.decl_printable_name(TYPE_NAME(type), 2);
+    expanded_location xloc = expand_location(DECL_SOURCE_LOCATION(TYPE_NAME(type)));
+    char numbers[96];
+    snprintf(numbers, sizeof(numbers), "\t%016llx\t%llu\t%u\t", (unsigned long long)hash,
+             (unsigned long long)size, align);
+    char line[32];
+    snprintf(line, sizeof(line), ":%d", xloc.line);
+    g_layouts[name] = std::string(name) + numbers + fields + "\t" + main_input_filename + "\t" +
+                      (xloc.file ? xloc.file : "<unknown>") + line;
+}
+
+// Helper to get the layout file of the unit when layout-out is a directory:
+// one file per unit, named after the unit's dump base name, which follows -o.
+static std::string get_unit_layout_path() {
+    std::string name(dump_base_name ? dump_base_name : main_input_filename);
+    std::replace(name.begin(), name.end(), '/', '_');
+    return std::string(g_options.layout_out) + "/" + name + ".layout";
+}
+
+// Writes the unit's layout lines, sorted. If layout-out is a directory, the
+// unit's own file there is replaced, so a rebuilt unit leaves no stale lines.
+// Otherwise the lines are appended to the layout file; a single append keeps
+// the lines of concurrent compiles from interleaving.
+static void write_layouts() {
+    if (!g_options.layout_out) return;
+    struct stat st;
+    bool per_unit = stat(g_options.layout_out, &st) == 0 && S_ISDIR(st.st_mode);
+    if (!per_unit && g_layouts.empty()) return;
+
+    std::vector<std::string> lines;
+    for (const auto &item : g_layouts) lines.push_back(item.second);
+    std::sort(lines.begin(), lines.end());
+    std::string text;
+    for (const std::string &line : lines) text += line + "\n";
+
+    std::string path = per_unit ? get_unit_layout_path() : g_options.layout_out;
+    std::string tmp_path = path;
+    if (per_unit) {
+        char tmp_suffix[32];
+        snprintf(tmp_suffix, sizeof(tmp_suffix), ".tmp.%d", (int)getpid());
+        tmp_path += tmp_suffix;
+    }
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | (per_unit ? O_TRUNC : O_APPEND), 0666);
+    bool ok = fd >= 0 && write(fd, text.data(), text.size()) == (ssize_t)text.size();
+    if (fd >= 0 && close(fd) != 0) ok = false;
+    if (ok && per_unit && rename(tmp_path.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        error("narrowing_cast_plugin: cannot write layout file %qs", path.c_str());
+        if (per_unit) unlink(tmp_path.c_str());
+    }
+    g_layouts.clear();
+}
+
+// Prints the analysis statistics of the unit to stderr.
+static void print_unit_stats() {
+    fprintf(stderr, "narrowing_cast_plugin: %s: analysis time %ld us\n", main_input_filename,
+            g_analysis_time);
+    fprintf(stderr, "narrowing_cast_plugin: %s: type cache %lu hits, %lu misses\n",
+            main_input_filename, g_type_descs.hits(), g_type_descs.misses());
+    fprintf(stderr, "narrowing_cast_plugin: %s: %lu initializer elements checked\n",
+            main_input_filename, g_initializer_elements);
+    fprintf(stderr, "narrowing_cast_plugin: %s: %u conversions checked\n", main_input_filename,
+            g_conversions_checked);
+    if (g_options.value_ranges) {
+        fprintf(stderr, "narrowing_cast_plugin: %s: %u conversions fit by value range\n",
+                main_input_filename, g_range_suppressed);
+    }
+    fprintf(stderr, "narrowing_cast_plugin: %s: pruned %u dead subtrees\n", main_input_filename,
+            g_pruned_subtrees);
+    if (g_options.prefilter) {
+        fprintf(stderr,
+                "narrowing_cast_plugin: %s: prefilter skipped %u of %u functions (%.1f%%) "
+                "in %ld us\n",
+                main_input_filename, g_prefilter_skipped, g_prefilter_functions,
+                g_prefilter_functions ? 100.0 * g_prefilter_skipped / g_prefilter_functions : 0.0,
+                g_prefilter_time);
+    }
+    if (g_options.fingerprint_db) {
+        fprintf(stderr, "narrowing_cast_plugin: %s: fingerprints %u unchanged, %lu analyzed\n",
+                main_input_filename, g_unchanged_functions,
+                (unsigned long)(g_function_fingerprints.size() - g_unchanged_functions));
+    }
+}
+
+// Writes the report of the unit to the report file and, when an object is
+// produced, to REPORT_SECTION so that ccache restores it with the object.
+static void write_report() {
+    if (g_options.report_file) {
+        FILE *file = fopen(g_options.report_file, "w");
+        if (!file) {
+            error("narrowing_cast_plugin: cannot write report file %qs", g_options.report_file);
+        } else {
+            fwrite(g_report.data(), 1, g_report.size(), file);
+            fclose(file);
+        }
+    }
+    // There is no assembly output with -fsyntax-only, nor after the compile
+    // closed it.
+    if (g_options.report_section && asm_out_file && !g_report.empty()) {
+        switch_to_section(get_section(REPORT_SECTION, SECTION_DEBUG, NULL));
+        assemble_string(g_report.data(), g_report.size());
+    }
+    g_report.clear();
+}
+
+static bool g_unit_finished;
+
+// Reports the findings of the unit and writes its outputs. Runs once, at the
+// first of the events below that the compile reaches.
+static void finish_unit() {
+    if (g_unit_finished) return;
+    g_unit_finished = true;
+    if (g_budget_skipped_functions) {
+        record_budget_finding(FINDING_BUDGET_SKIPPED, input_location, "",
+                              g_budget_skipped_functions);
+    }
+    flush_findings();
+    report_field_stores();
+    write_report();
+    if (g_options.instrument) {
+        report_check_sites();
+    }
+    if (g_options.stats) {
+        print_unit_stats();
+    }
+    save_fingerprint_db();
+    write_layouts();
+    g_initializer_stores.clear();
+}
+
+// Callback for the PLUGIN_FINISH_UNIT event.
+static void finish_unit_callback(void *gcc_data, void *user_data) {
+    (void)gcc_data;
+    (void)user_data;
+    finish_unit();
+}
+
+// Callback for the PLUGIN_FINISH_PARSE_FILE event. compile_file() returns
+// before PLUGIN_FINISH_UNIT with -fsyntax-only and once an error was seen, so
+// such units are finished right after parsing.
+static void finish_parse_file_callback(void *gcc_data, void *user_data) {
+    (void)gcc_data;
+    (void)user_data;
+    if (flag_syntax_only || seen_error()) finish_unit();
+}
+
+// Callback for the PLUGIN_FINISH event. Errors after parsing, e.g. from
+// -Werror, also skip PLUGIN_FINISH_UNIT; whatever is left is reported here.
+static void finish_callback(void *gcc_data, void *user_data) {
+    (void)gcc_data;
+    (void)user_data;
+    finish_unit();
+}
+
+// Helper to interpret a boolean plugin argument; a bare key means true.
+static bool parse_bool_arg(const char *value) {
+    return !value || !(strcmp(value, "0") == 0 || strcmp(value, "no") == 0 ||
+                       strcmp(value, "false") == 0);
+}
+
+// Reads -fplugin-arg-<name>-<key>[=<value>] arguments into g_options.
+static void parse_plugin_args(struct plugin_name_args *plugin_info) {
+    for (int i = 0; i < plugin_info->argc; ++i) {
+        const char *key = plugin_info->argv[i].key;
+        const char *value = plugin_info->argv[i].value;
+
+        if (strcmp(key, "taint") == 0) {
+            g_options.taint = parse_bool_arg(value);
+        } else if (strcmp(key, "field-report") == 0) {
+            g_options.field_report = parse_bool_arg(value);
+        } else if (strcmp(key, "macro-aggregate") == 0) {
+            g_options.macro_aggregate = parse_bool_arg(value);
+        } else if (strcmp(key, "macro-samples") == 0 && value) {
+            g_options.macro_samples = atoi(value);
+        } else if (strcmp(key, "node-budget") == 0 && value) {
+            g_options.node_budget = atoi(value);
+        } else if (strcmp(key, "time-budget-ms") == 0 && value) {
+            g_options.time_budget_ms = atoi(value);
+        } else if (strcmp(key, "type-cache") == 0) {
+            g_options.type_cache = parse_bool_arg(value);
+        } else if (strcmp(key, "stats") == 0) {
+            g_options.stats = parse_bool_arg(value);
+        } else if (strcmp(key, "y2038-only") == 0) {
+            g_options.y2038_only = parse_bool_arg(value);
+        } else if (strcmp(key, "time-typedefs") == 0 && value) {
+            g_options.time_typedefs = value;
+        } else if (strcmp(key, "suppress") == 0 && value) {
+            g_options.suppress_file = value;
+        } else if (strcmp(key, "daemon") == 0 && value) {
+            g_options.daemon_socket = value;
+        } else if (strcmp(key, "daemon-bin") == 0 && value) {
+            g_options.daemon_bin = value;
+        } else if (strcmp(key, "report") == 0 && value) {
+            g_options.report_file = value;
+        } else if (strcmp(key, "report-section") == 0) {
+            g_options.report_section = parse_bool_arg(value);
+        } else if (strcmp(key, "print-config-hash") == 0) {
+            g_options.print_config_hash = parse_bool_arg(value);
+        } else if (strcmp(key, "fingerprint-db") == 0 && value) {
+            g_options.fingerprint_db = value;
+        } else if (strcmp(key, "replay-findings") == 0) {
+            g_options.replay_findings = parse_bool_arg(value);
+        } else if (strcmp(key, "prefilter") == 0) {
+            g_options.prefilter = parse_bool_arg(value);
+        } else if (strcmp(key, "rules") == 0 && value) {
+            g_options.rules = value;
+        } else if (strcmp(key, "ilp32") == 0) {
+            g_options.ilp32 = parse_bool_arg(value);
+        } else if (strcmp(key, "layout-out") == 0 && value) {
+            g_options.layout_out = value;
+        } else if (strcmp(key, "value-ranges") == 0) {
+            g_options.value_ranges = parse_bool_arg(value);
+        } else if (strcmp(key, "instrument") == 0) {
+            g_options.instrument = parse_bool_arg(value);
+        } else if (strcmp(key, "check-budget") == 0 && value) {
+            g_options.check_budget = strtoull(value, NULL, 10);
+        } else if (strcmp(key, "known-apis") == 0 && value) {
+            g_options.known_apis_file = value;
+        } else {
+            warning(0, "%s: unknown argument %qs", plugin_info->base_name, key);
+        }
+    }
+}
+
+// Hash of everything that can change the plugin's output: its version, its
+// arguments in a canonical order, and the contents of the files they name.
+// Arguments that only say where to find the daemon are left out.
+static uint64_t compute_config_hash(struct plugin_name_args *plugin_info) {
+    std::vector<std::pair<std::string, std::string> > args;
+    for (int i = 0; i < plugin_info->argc; ++i) {
+        const char *key = plugin_info->argv[i].key;
+        const char *value = plugin_info->argv[i].value;
+        if (strcmp(key, "daemon") == 0 || strcmp(key, "daemon-bin") == 0 ||
+            strcmp(key, "print-config-hash") == 0) {
+            continue;
+        }
+        args.push_back(std::make_pair(std::string(key), std::string(value ? value : "")));
+    }
+    std::sort(args.begin(), args.end());
+
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_bytes(hash, my_plugin_info.version, strlen(my_plugin_info.version) + 1);
+    for (const std::pair<std::string, std::string> &arg : args) {
+        hash = hash_bytes(hash, arg.first.c_str(), arg.first.size() + 1);
+        hash = hash_bytes(hash, arg.second.c_str(), arg.second.size() + 1);
+        if (arg.first != "known-apis" && arg.first != "suppress") continue;
+        hash = hash_file(hash, arg.second.c_str());
+    }
+    return hash;
 }
 
 // Plugin entry point
@@ -466,7 +4347,68 @@ int plugin_init(struct plugin_name_args *plugin_info, struct plugin_gcc_version
         return 1;
     }
 
+    parse_plugin_args(plugin_info);
+    g_config_hash = compute_config_hash(plugin_info);
+    if (g_options.print_config_hash) {
+        fprintf(stdout, "narrowing_cast_plugin %016llx\n", (unsigned long long)g_config_hash);
+        fflush(stdout);
+    }
+    if (g_options.fingerprint_db && (g_options.taint || g_options.field_report)) {
+        // Skipped functions would lose their taint summaries and field stores.
+        warning(0, "narrowing_cast_plugin: %qs is ignored with %qs and %qs", "fingerprint-db",
+                "taint", "field-report");
+        g_options.fingerprint_db = NULL;
+    }
+    if (g_options.fingerprint_db && g_options.instrument) {
+        // Skipped functions would get no checks.
+        warning(0, "narrowing_cast_plugin: %qs is ignored with %qs", "fingerprint-db",
+                "instrument");
+        g_options.fingerprint_db = NULL;
+    }
+    init_daemon();
+    init_known_apis(g_options.known_apis_file);
+    init_time_typedefs(g_options.time_typedefs);
+    init_file_size_typedefs();
+    init_ilp32_model();
+    init_rules(g_options.rules);
+
     register_callback(plugin_info->base_name, PLUGIN_PRE_GENERICIZE, pre_genericize_callback, NULL);
+    register_callback(plugin_info->base_name, PLUGIN_FINISH_DECL, finish_decl_callback, NULL);
+    register_callback(plugin_info->base_name, PLUGIN_FINISH_PARSE_FILE, finish_parse_file_callback,
+                      NULL);
+    register_callback(plugin_info->base_name, PLUGIN_FINISH_UNIT, finish_unit_callback, NULL);
+    register_callback(plugin_info->base_name, PLUGIN_FINISH, finish_callback, NULL);
+    if (g_options.layout_out) {
+        register_callback(plugin_info->base_name, PLUGIN_FINISH_TYPE, finish_type_callback, NULL);
+    }
+
+    struct register_pass_info ipa_taint_pass_info;
+    ipa_taint_pass_info.pass = new pass_ipa_time_taint(g);
+    ipa_taint_pass_info.reference_pass_name = "whole-program";
+    ipa_taint_pass_info.ref_pass_instance_number = 1;
+    ipa_taint_pass_info.pos_op = PASS_POS_INSERT_AFTER;
+    register_callback(plugin_info->base_name, PLUGIN_PASS_MANAGER_SETUP, NULL,
+                      &ipa_taint_pass_info);
+
+    struct register_pass_info profile_pass_info;
+    profile_pass_info.pass = new pass_profile_counts(g);
+    profile_pass_info.reference_pass_name = "ehdisp";
+    profile_pass_info.ref_pass_instance_number = 1;
+    profile_pass_info.pos_op = PASS_POS_INSERT_AFTER;
+    register_callback(plugin_info->base_name, PLUGIN_PASS_MANAGER_SETUP, NULL,
+                      &profile_pass_info);
+
+    if (g_options.instrument) {
+        register_callback(plugin_info->base_name, PLUGIN_REGISTER_GGC_ROOTS, NULL,
+                          (void *)check_fns_root_tab);
+        struct register_pass_info checks_pass_info;
+        checks_pass_info.pass = new pass_runtime_checks(g);
+        checks_pass_info.reference_pass_name = "ehdisp";
+        checks_pass_info.ref_pass_instance_number = 1;
+        checks_pass_info.pos_op = PASS_POS_INSERT_AFTER;
+        register_callback(plugin_info->base_name, PLUGIN_PASS_MANAGER_SETUP, NULL,
+                          &checks_pass_info);
+    }
 
     return 0;
 }
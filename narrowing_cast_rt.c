@@ -0,0 +1,44 @@
+/*
+ * Runtime support for the narrowing cast plugin's instrument option.
+ * The plugin inserts a call before each checked cast, with the value before
+ * the cast, the range of the target type and the cast's source line. Values
+ * out of range are reported on stderr; if NARROWING_CAST_ABORT is set in the
+ * environment, the first one also aborts the program.
+ * License: GPLv3
+ *
+ * Link narrowing_cast_rt.o into every program built with instrument.
+ */
+
+// Standard Headers
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helper to abort after a report if NARROWING_CAST_ABORT is set.
+static void finish_report(void) {
+    if (getenv("NARROWING_CAST_ABORT")) abort();
+}
+
+// Helper to describe how often a site is checked.
+static const char *get_sampling_note(unsigned period, char *buf, size_t size) {
+    buf[0] = '\0';
+    if (period > 1) snprintf(buf, size, " (checked once every %u executions)", period);
+    return buf;
+}
+
+void __narrowing_cast_check_s(long long value, long long min, long long max, const char *site,
+                              unsigned period) {
+    if (value >= min && value <= max) return;
+    char note[64];
+    fprintf(stderr, "%s: narrowing cast of %lld out of range [%lld, %lld]%s\n", site, value, min,
+            max, get_sampling_note(period, note, sizeof(note)));
+    finish_report();
+}
+
+void __narrowing_cast_check_u(unsigned long long value, unsigned long long min,
+                              unsigned long long max, const char *site, unsigned period) {
+    if (value >= min && value <= max) return;
+    char note[64];
+    fprintf(stderr, "%s: narrowing cast of %llu out of range [%llu, %llu]%s\n", site, value, min,
+            max, get_sampling_note(period, note, sizeof(note)));
+    finish_report();
+}
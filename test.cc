@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <cstdio>
 
 // Function declarations for testing
 void takes_32bit_integer(int32_t i) { (void)i; }
@@ -84,6 +85,46 @@ void test_float_to_int_conversion() {
     int32_t i32 = d64; // WARNING
 }
 
+void test_format_strings() {
+    int64_t i64 = 5;
+    printf("%d\n", i64); // WARNING: varargs have no parameter type
+    printf("%lld\n", (long long)i64); // OK
+    printf("%m: %d\n", i64); // WARNING: %m takes no argument
+
+    int64_t parsed = 0;
+    sscanf("5", "%d", &parsed); // WARNING: stores only an int
+}
+void test_value_ranges() {
+    int64_t t = 7;
+    int32_t low_bits = t & 0xffff; // OK: the mask bounds the value
+    int32_t minutes = (t / 60) % 60; // OK
+    int32_t shifted = t >> 8; // WARNING: still wider than 32 bits
+}
+void test_dead_code() {
+    int64_t i64 = 8;
+    if (0) {
+        int32_t never = i64; // OK: never executed
+    }
+    while (0) {
+        int32_t skipped = i64; // OK: never executed
+    }
+}
+
+// Namespace-scope and static initializers
+int64_t g_wide = 6;
+int32_t g_narrowed = g_wide; // WARNING
+const int32_t g_table[] = {1, 2, 3}; // OK: constants that fit
+int32_t g_stamps[] = {1, static_cast<int32_t>(g_wide), 3}; // WARNING: (1 of 3 elements)
+struct time_pair {
+    int32_t secs;
+    int32_t usecs;
+};
+time_pair g_pair = {static_cast<int32_t>(g_wide), (int32_t)g_wide}; // WARNING: (2 of 2 elements)
+
+int32_t first_stamp(int64_t now) {
+    static int32_t first = now; // WARNING: function-local static
+    return first;
+}
 
 int main() {
     test_implicit_conversion();
@@ -92,6 +133,10 @@ int main() {
     test_function_returns();
     test_int_to_float_conversion();
     test_float_to_int_conversion();
+    test_format_strings();
+    test_value_ranges();
+    test_dead_code();
+    first_stamp(g_wide);
     return 0;
 }
 
@@ -0,0 +1,23 @@
+#include <cstdint>
+
+// Build with -fprofile-generate, run, then compile with -fprofile-use,
+// -fplugin-arg-narrowing_cast_plugin-instrument and
+// -fplugin-arg-narrowing_cast_plugin-check-budget=100. The cold cast runs
+// once and is checked on every execution; the hot one runs 1024 times and is
+// sampled once every 16 executions, for 1 + 64 = 65 expected checks.
+
+int32_t g_sink;
+
+void cold(int64_t value) {
+    g_sink = (int32_t)value;  // WARNING: full check
+}
+
+void hot(int64_t value) {
+    g_sink = (int32_t)value;  // WARNING: sampled check
+}
+
+int main() {
+    cold(1);
+    for (int i = 0; i < 1024; ++i) hot(i);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <cstdint>
+#include <ctime>
+
+// Compile with -fplugin-arg-narrowing_cast_plugin-field-report: the lossy
+// stores below are reported once, at the field they write.
+
+struct record {
+    int32_t secs;   // WARNING: receives 3 lossy store(s)
+    int32_t flags;  // OK: only stores that fit
+};
+
+void fill(record *r, time_t now) {
+    r->secs = now;
+    r->flags = 1;
+}
+
+void refill(record &r, time_t now) {
+    r.secs = now + 1;
+}
+
+void stamp(record *r, time_t later) {
+    r->secs = (int32_t)later;
+}
+
+int main() {
+    record r;
+    fill(&r, time(nullptr));
+    refill(r, time(nullptr));
+    stamp(&r, time(nullptr));
+    return r.flags - 1;
+}
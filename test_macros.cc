@@ -0,0 +1,20 @@
+#include <cstdint>
+
+// Compile with -fplugin-arg-narrowing_cast_plugin-macro-aggregate and
+// -fplugin-arg-narrowing_cast_plugin-macro-samples=2: the conversion inside
+// STORE32 is reported once, at the macro, with 4 uses.
+
+#define STORE32(dst, src) ((dst) = (src))  // WARNING: 4 uses, 2 sites listed
+
+int32_t narrow_all(int64_t a, int64_t b, int64_t c, int64_t d) {
+    int32_t x = 0;
+    STORE32(x, a);
+    STORE32(x, b);
+    STORE32(x, c);
+    STORE32(x, d);
+    return x;
+}
+
+int main() {
+    return narrow_all(1, 2, 3, 4) - 4;
+}
@@ -0,0 +1,25 @@
+#include <cstdint>
+#include <sys/types.h>
+
+// Compile with -fplugin-arg-narrowing_cast_plugin-rules=y2038,large-file,ptr-trunc
+// and -fpermissive, which lets the pointer cast below through with a warning.
+// Each conversion is reported once, by the most specific rule.
+
+int32_t narrow_offset(off_t offset) {
+    int32_t low = offset;  // WARNING: large-file issue
+    return low;
+}
+
+int32_t narrow_count(int64_t count) {
+    int32_t low = count;  // WARNING: Y2038 potential issue
+    return low;
+}
+
+int32_t narrow_pointer(void *p) {
+    int32_t low = (int32_t)p;  // WARNING: pointer truncation
+    return low;
+}
+
+int main() {
+    return narrow_offset(0) + narrow_count(0) + (narrow_pointer(nullptr) != 0);
+}
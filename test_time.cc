@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <ctime>
+#include <sys/time.h>
+
+// Compile with -fplugin-arg-narrowing_cast_plugin-taint: only conversions of
+// time-derived values are reported.
+
+int32_t now_seconds() {
+    time_t now = time(nullptr);
+    return now; // WARNING
+}
+
+void test_untainted() {
+    int64_t counter = 1;
+    int32_t small = counter; // OK in taint mode: not time-derived
+    (void)small;
+}
+
+void test_propagation() {
+    long raw;
+    time(&raw);
+    long later = raw + 60;
+    int32_t stamp = later; // WARNING: tainted through time() out-parameter
+    (void)stamp;
+}
+
+void test_timespec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int32_t secs = ts.tv_sec; // WARNING
+    (void)secs;
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int32_t usecs = tv.tv_usec; // WARNING
+    (void)usecs;
+}
+
+int main() {
+    now_seconds();
+    test_untainted();
+    test_propagation();
+    test_timespec();
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <cstdint>
+
+// Compiled together with test_time_return_2.cc by make test-time-lto: the
+// time value only reaches this unit through read_clock()'s return value, so
+// only the IPA pass can see it.
+
+long read_clock();  // Defined in test_time_return_2.cc.
+
+int32_t stamp() {
+    long now = read_clock();
+    return now; // WARNING: narrows the time-derived value returned by read_clock
+}
+
+int32_t untimed(long value) {
+    return value; // OK in taint mode: not time-derived
+}
+
+int main() {
+    return stamp() + untimed(1) ? 0 : 1;
+}